@@ -0,0 +1,206 @@
+#include "input_reader.hpp"
+#include "personnummer.hpp"
+#include "pipeline.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+/*
+ * Compare the input backends of the bulk validator on one file, both reading
+ * it alone and running the whole pipeline with output to /dev/null. With
+ * `--cold` the file is dropped from the page cache before every run, so the
+ * disk is measured rather than memory copies; that needs a file that isn't
+ * otherwise in use. `--generate` first writes a file of `lines` million
+ * numbers, about 12 MB per million.
+ *
+ *   bench_input <file> [--generate lines] [--cold] [--depth N]
+ *               [--block-size BYTES]
+ */
+struct Options
+{
+  bool cold;
+  unsigned depth;
+  std::size_t block_size;
+};
+
+template <typename F> double measure(F fn)
+{
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  fn();
+
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+bool generate(const char *path, std::size_t millions)
+{
+  std::FILE *file = std::fopen(path, "wb");
+
+  if (file == nullptr)
+    return false;
+
+  std::mt19937 random(1);
+  std::string chunk;
+
+  for (std::size_t i = 0; i < millions * 1000; ++i)
+  {
+    chunk.clear();
+
+    for (int j = 0; j < 1000; ++j)
+    {
+      char body[10];
+      std::snprintf(body, sizeof(body), "%02u%02u%02u%03u",
+                    static_cast<unsigned>(random() % 100),
+                    static_cast<unsigned>(1 + random() % 12),
+                    static_cast<unsigned>(1 + random() % 28),
+                    static_cast<unsigned>(random() % 1000));
+      int control = j % 8 ? luhn(body, body + 9) : random() % 10;
+
+      chunk.append(body, 6);
+      chunk += '-';
+      chunk.append(body + 6, 3);
+      chunk += static_cast<char>('0' + control);
+      chunk += '\n';
+    }
+
+    if (std::fwrite(chunk.data(), 1, chunk.size(), file) != chunk.size())
+    {
+      std::fclose(file);
+      return false;
+    }
+  }
+
+  return std::fclose(file) == 0;
+}
+
+int open_input(const char *path, const Options &options)
+{
+  int fd = open(path, O_RDONLY);
+
+  if (fd >= 0 && options.cold)
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+
+  return fd;
+}
+
+void report(const char *what, InputBackend wanted, const InputReader &reader,
+            std::size_t bytes, double seconds, bool failed)
+{
+  std::cout << what << " " << backend_name(wanted);
+
+  if (reader.backend() != wanted)
+    std::cout << " (as " << backend_name(reader.backend()) << ")";
+
+  std::cout << ": " << seconds * 1000 << " ms, " << bytes / seconds / 1e6
+            << " MB/s" << (failed ? ", failed" : "") << "\n";
+}
+
+void run(const char *path, InputBackend backend, const Options &options,
+         std::FILE *null)
+{
+  std::vector<char> buffer(1 << 20);
+  std::size_t bytes = 0;
+  std::size_t lines = 0;
+
+  int fd = open_input(path, options);
+  std::FILE *file = backend == InputBackend::stdio ? fdopen(fd, "rb") : nullptr;
+
+  {
+    InputReader reader(fd, backend, options.block_size, options.depth);
+    InputReader stdio_reader(file);
+    InputReader &in = file ? stdio_reader : reader;
+    double seconds = measure([&] {
+      std::size_t got;
+
+      do
+      {
+        got = in.read(buffer.data(), buffer.size());
+        bytes += got;
+        lines += std::count(buffer.data(), buffer.data() + got, '\n');
+      } while (got == buffer.size());
+    });
+
+    report("read", backend, in, bytes, seconds, in.failed());
+  }
+
+  file ? std::fclose(file) : close(fd);
+  fd = open_input(path, options);
+  file = backend == InputBackend::stdio ? fdopen(fd, "rb") : nullptr;
+
+  {
+    InputReader reader(fd, backend, options.block_size, options.depth);
+    InputReader stdio_reader(file);
+    InputReader &in = file ? stdio_reader : reader;
+    PipelineStats stats = run_pipeline(in, null);
+
+    report("pipeline", backend, in, stats.reader.bytes, stats.seconds,
+           stats.failed || stats.records < lines);
+  }
+
+  file ? std::fclose(file) : close(fd);
+}
+
+int main(int argc, char **argv)
+{
+  Options options = {false, 4, 1 << 20};
+  std::size_t millions = 0;
+
+  for (int i = 2; i < argc; ++i)
+  {
+    if (std::strcmp(argv[i], "--cold") == 0)
+      options.cold = true;
+    else if (i + 1 < argc && std::strcmp(argv[i], "--generate") == 0)
+      millions = std::strtoul(argv[++i], nullptr, 10);
+    else if (i + 1 < argc && std::strcmp(argv[i], "--depth") == 0)
+      options.depth =
+          static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+    else if (i + 1 < argc && std::strcmp(argv[i], "--block-size") == 0)
+      options.block_size = std::strtoul(argv[++i], nullptr, 10);
+    else
+      argc = 0;
+  }
+
+  if (argc < 2)
+  {
+    std::cerr << "usage: bench_input <file> [--generate lines] [--cold] "
+                 "[--depth N] [--block-size BYTES]\n";
+    return 2;
+  }
+
+  if (millions > 0 && !generate(argv[1], millions))
+  {
+    std::cerr << "failed to write " << argv[1] << "\n";
+    return 1;
+  }
+
+  std::FILE *null = std::fopen("/dev/null", "wb");
+
+  if (null == nullptr || access(argv[1], R_OK) != 0)
+  {
+    std::cerr << "failed to open " << argv[1] << "\n";
+    return 1;
+  }
+
+  const InputBackend backends[] = {InputBackend::stdio, InputBackend::read,
+                                   InputBackend::pread, InputBackend::mmap,
+                                   InputBackend::io_uring};
+
+  for (InputBackend backend : backends)
+    run(argv[1], backend, options, null);
+
+  std::fclose(null);
+
+  return 0;
+}
+
+// vim: set ts=2 sw=2 et:
@@ -0,0 +1,133 @@
+#include "normalize.hpp"
+#include "personnummer.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+/*
+ * Compare normalising and validating messy input in one pass with a separate
+ * normalisation pass on strings followed by the regex parser, which is what
+ * callers had to do before.
+ *
+ *   bench_normalize [count]
+ */
+template <typename F> double measure(F fn)
+{
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  fn();
+
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+void report(const char *name, std::size_t count, std::size_t bytes,
+            double seconds, std::size_t valid)
+{
+  std::cout << name << ": " << seconds * 1000 << " ms, "
+            << count / seconds / 1e6 << " M numbers/s, "
+            << bytes / seconds / 1e6 << " MB/s, " << valid << " valid\n";
+}
+
+void replace_all(std::string &text, const std::string &from, const char *to)
+{
+  for (std::size_t at = text.find(from); at != std::string::npos;
+       at = text.find(from, at))
+    text.replace(at, from.size(), to);
+}
+
+int main(int argc, char **argv)
+{
+  std::size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 100000;
+  std::mt19937 random(1);
+
+  // Dividers and padding seen in real input, hex escapes split from digits.
+  const std::vector<std::string> dividers = {
+      "-", "", " ", "\xe2\x80\x90", "\xe2\x80\x93", "\xe2\x80\x94",
+      "\xc2\xa0-\xc2\xa0"};
+  const std::vector<std::string> padding = {"", " ", "\t", "\xc2\xa0",
+                                            "\xe3\x80\x80"};
+  const std::vector<std::string> fullwidth = {
+      "\xef\xbc\x90", "\xef\xbc\x91", "\xef\xbc\x92", "\xef\xbc\x93",
+      "\xef\xbc\x94", "\xef\xbc\x95", "\xef\xbc\x96", "\xef\xbc\x97",
+      "\xef\xbc\x98", "\xef\xbc\x99"};
+
+  std::vector<std::string> corpus(count);
+  std::size_t bytes = 0;
+
+  for (auto &line : corpus)
+  {
+    char digits[11];
+    std::snprintf(digits, sizeof(digits), "%02u%02u%02u%03u",
+                  static_cast<unsigned>(random() % 100),
+                  static_cast<unsigned>(1 + random() % 12),
+                  static_cast<unsigned>(1 + random() % 28),
+                  static_cast<unsigned>(random() % 1000));
+    digits[9] = static_cast<char>('0' + luhn(digits, digits + 9));
+
+    std::string body;
+
+    for (std::size_t i = 0; i < 10; ++i)
+    {
+      if (i == 6)
+        body += dividers[random() % dividers.size()];
+
+      if (random() % 4 == 0)
+        body += fullwidth[digits[i] - '0'];
+      else
+        body += digits[i];
+    }
+
+    line = padding[random() % padding.size()] + body +
+           padding[random() % padding.size()];
+    bytes += line.size();
+  }
+
+  std::cout << "normalising " << count << " numbers, " << bytes << " bytes\n";
+
+  std::size_t valid = 0;
+  double seconds = measure([&]() {
+    for (std::string line : corpus)
+    {
+      for (const auto &divider : dividers)
+        if (divider.size() > 1 && divider[0] != '\xc2')
+          replace_all(line, divider, "-");
+
+      for (std::size_t digit = 0; digit < fullwidth.size(); ++digit)
+        replace_all(line, fullwidth[digit],
+                    std::string(1, '0' + digit).c_str());
+
+      for (const auto &space : padding)
+        if (!space.empty())
+          replace_all(line, space, "");
+
+      valid += Personnummer(line).valid();
+    }
+  });
+  report("replace and regex", count, bytes, seconds, valid);
+
+  valid = 0;
+  seconds = measure([&]() {
+    char buffer[max_formatted_length];
+
+    for (const auto &line : corpus)
+      valid += normalize_personnummer(line.data(), line.size(), buffer) > 0;
+  });
+  report("normalize_personnummer", count, bytes, seconds, valid);
+
+  valid = 0;
+  seconds = measure([&]() {
+    for (const auto &line : corpus)
+      valid += NormalizedPersonnummer(line).valid();
+  });
+  report("NormalizedPersonnummer::valid", count, bytes, seconds, valid);
+
+  return 0;
+}
+
+// vim: set ts=2 sw=2 et:
@@ -0,0 +1,86 @@
+#include "personnummer.hpp"
+#include "radix_sort.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * Compare sorting numbers by their formatted string, which is what callers
+ * had to do before there was a canonical key, with sorting the keys.
+ *
+ *   bench_sort [count]
+ */
+template <typename F> double measure(F fn)
+{
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  fn();
+
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+void report(const char *name, std::size_t count, double seconds)
+{
+  std::cout << name << ": " << seconds * 1000 << " ms, "
+            << count / seconds / 1e6 << " M numbers/s\n";
+}
+
+int main(int argc, char **argv)
+{
+  std::size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 10000000;
+  std::mt19937 random(1);
+  std::vector<std::uint64_t> keys(count);
+
+  for (auto &key : keys)
+  {
+    std::uint64_t year = 1900 + random() % 120;
+    std::uint64_t month = 1 + random() % 12;
+    std::uint64_t day = 1 + random() % 28;
+    std::uint64_t serial = random() % 1000;
+
+    key = year * 100000000ULL + month * 1000000ULL + day * 10000ULL +
+          serial * 10ULL;
+  }
+
+  std::vector<std::string> strings(count);
+
+  for (std::size_t i = 0; i < count; ++i)
+    strings[i] = Personnummer::from_canonical_key(keys[i]).format(true);
+
+  unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+
+  std::cout << "sorting " << count << " numbers\n";
+  report("std::sort on format(true)", count,
+         measure([&]() { std::sort(strings.begin(), strings.end()); }));
+
+  std::vector<std::uint64_t> copy = keys;
+  report("std::sort on keys", count,
+         measure([&]() { std::sort(copy.begin(), copy.end()); }));
+
+  copy = keys;
+  report("radix_sort on keys", count,
+         measure([&]() { radix_sort(copy.data(), copy.size()); }));
+
+  copy = keys;
+  std::string name = "radix_sort on keys, " + std::to_string(threads) +
+                     " threads";
+  report(name.c_str(), count,
+         measure([&]() { radix_sort(copy.data(), copy.size(), threads); }));
+
+  std::vector<std::uint64_t> grouped(count);
+  report("group_by_birth_date", count, measure([&]() {
+           group_by_birth_date(keys.data(), keys.size(), 1900, 2019,
+                               grouped.data());
+         }));
+
+  return 0;
+}
+
+// vim: set ts=2 sw=2 et:
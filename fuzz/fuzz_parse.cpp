@@ -0,0 +1,91 @@
+#include "classify.hpp"
+#include "normalize.hpp"
+#include "personnummer.hpp"
+#include "serialize.hpp"
+#include "view.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <regex>
+#include <string>
+
+/*
+ * Differential fuzz target. Every parser and validator in the library must
+ * agree with the regex based `Personnummer` constructor, which is the
+ * reference implementation. Any disagreement aborts so the fuzzer saves the
+ * input.
+ */
+static void require(bool condition)
+{
+  if (!condition)
+    std::abort();
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t *data,
+                                      std::size_t size)
+{
+  // Nothing longer than a long format number can match, and the regex is slow
+  // enough to make long inputs a waste of fuzzing time.
+  if (size > 32)
+    return 0;
+
+  static const std::regex pnr_regex(
+      "^(\\d{2})?(\\d{2})(\\d{2})(\\d{2})([-+]?)?(\\d{3})(\\d?)$");
+
+  std::string input(reinterpret_cast<const char *>(data), size);
+  Personnummer reference(input);
+  bool matches = std::regex_search(input, pnr_regex);
+  std::uint64_t key = reference.canonical_key();
+  bool valid = reference.valid();
+
+  PersonnummerView view(input.data(), input.size());
+  require(view.well_formed() == matches);
+  require(view.canonical_key() == key);
+  require(view.valid() == valid);
+
+  char buffer[max_formatted_length];
+  for (bool long_format : {false, true})
+  {
+    std::size_t length = reference.format_to(buffer, long_format);
+    require(std::string(buffer, length) == reference.format(long_format));
+    require(view.format(long_format) == reference.format(long_format));
+  }
+
+  Personnummer from_key = Personnummer::from_canonical_key(key);
+  require(from_key == reference);
+  require(from_key.valid() == valid);
+
+  unsigned char record[binary_record_size];
+  encode_binary(reference, record);
+  require(decode_binary(record) == reference);
+
+  Identity identity = classify_identity(input);
+  bool personal = identity.type == IdentityType::personnummer ||
+                  identity.type == IdentityType::samordningsnummer;
+  require(personal == valid);
+  require(!personal || identity.key == key);
+  require(!personal || (identity.type == IdentityType::samordningsnummer) ==
+                           reference.is_coordination_number());
+
+  // Normalising only ever leaves digits and dividers, keeps input that has
+  // nothing else as is, and what it leaves parses like the reference.
+  char normalized[max_formatted_length];
+  std::size_t length = normalize_personnummer(input.data(), size, normalized);
+  bool plain = size <= max_formatted_length &&
+               input.find_first_not_of("0123456789+-") == std::string::npos;
+  require(!plain || std::string(normalized, length) == input);
+
+  for (std::size_t i = 0; i < length; ++i)
+    require((normalized[i] >= '0' && normalized[i] <= '9') ||
+            normalized[i] == '+' || normalized[i] == '-');
+
+  Personnummer from_normalized(std::string(normalized, length));
+  NormalizedPersonnummer parsed(input);
+  require(parsed.size() == length);
+  require(parsed.view().canonical_key() == from_normalized.canonical_key());
+  require(parsed.valid() == from_normalized.valid());
+
+  return 0;
+}
+
+// vim: set ts=2 sw=2 et:
@@ -0,0 +1,78 @@
+#include "scan.hpp"
+#include "view.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+/*
+ * Differential fuzz target for the text scanner. The vectorised scanner must
+ * find exactly the numbers a brute force search over every position finds.
+ */
+static void require(bool condition)
+{
+  if (!condition)
+    std::abort();
+}
+
+static bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+static bool is_candidate(const char *s, std::size_t length)
+{
+  std::size_t digits = 0;
+
+  while (digits < length && is_digit(s[digits]))
+    ++digits;
+
+  if (digits == length)
+    return length == 10 || length == 12;
+
+  return (digits == 6 || digits == 8) && length == digits + 5;
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t *data,
+                                      std::size_t size)
+{
+  const char *text = reinterpret_cast<const char *>(data);
+  std::vector<ScanMatch> expected;
+
+  for (std::size_t i = 0; i < size; ++i)
+  {
+    if (!is_digit(text[i]) || (i > 0 && is_digit(text[i - 1])))
+      continue;
+
+    for (std::size_t length = 10; length <= 13 && i + length <= size; ++length)
+    {
+      bool bounded = i + length == size || !is_digit(text[i + length]);
+
+      if (bounded && is_candidate(text + i, length) &&
+          PersonnummerView(text + i, length).valid())
+      {
+        ScanMatch match = {i, length};
+        expected.push_back(match);
+      }
+    }
+  }
+
+  std::vector<ScanMatch> found = find_all_personnummer(text, size);
+  require(found.size() == expected.size());
+
+  for (std::size_t i = 0; i < found.size(); ++i)
+  {
+    require(found[i].offset == expected[i].offset);
+    require(found[i].length == expected[i].length);
+  }
+
+  // Resuming from arbitrary positions must not find anything new.
+  for (std::size_t from = 0; from < size; from += 7)
+  {
+    ScanMatch match;
+
+    if (find_personnummer(text, size, from, &match, 1) == 1)
+      require(match.offset >= from);
+  }
+
+  return 0;
+}
+
+// vim: set ts=2 sw=2 et:
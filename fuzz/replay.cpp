@@ -0,0 +1,39 @@
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+/*
+ * Runs a fuzz target on the files given as arguments. Used instead of libFuzzer
+ * when building with a compiler that doesn't have it, to replay the corpus or a
+ * crashing input.
+ */
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t *data,
+                                      std::size_t size);
+
+int main(int argc, char **argv)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    std::ifstream in(argv[i], std::ios::binary);
+
+    if (!in)
+    {
+      std::cerr << "failed to open " << argv[i] << "\n";
+      return 1;
+    }
+
+    std::vector<std::uint8_t> input((std::istreambuf_iterator<char>(in)),
+                                    std::istreambuf_iterator<char>());
+
+    LLVMFuzzerTestOneInput(input.data(), input.size());
+  }
+
+  std::cout << "replayed " << argc - 1 << " inputs\n";
+
+  return 0;
+}
+
+// vim: set ts=2 sw=2 et:
@@ -0,0 +1,152 @@
+#include "age.hpp"
+#include <ctime>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PERSONNUMMER_SSE2
+#endif
+
+namespace
+{
+std::int32_t birth_date(std::uint64_t key)
+{
+  std::int32_t date = static_cast<std::int32_t>(key / 10000);
+
+  if (date % 100 > coordination_extra)
+    date -= coordination_extra;
+
+  return date;
+}
+
+// Offset added before dividing so the dividend is never negative, which lets
+// the division round down for birth dates after the reference date too.
+const std::int32_t age_bias = 10000;
+
+std::int32_t age(std::int32_t birth_date, std::int32_t reference)
+{
+  return (reference - birth_date + age_bias * 10000) / 10000 - age_bias;
+}
+} // namespace
+
+void birth_date_column(const Personnummer *pnrs, std::size_t count,
+                       std::int32_t *birth_dates)
+{
+  for (std::size_t i = 0; i < count; ++i)
+    birth_dates[i] = birth_date(pnrs[i].canonical_key());
+}
+
+void birth_date_column(const pnr_record *records, std::size_t count,
+                       std::int32_t *birth_dates)
+{
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    std::int32_t day = records[i].day;
+
+    if (day > coordination_extra)
+      day -= coordination_extra;
+
+    birth_dates[i] = records[i].year * 10000 + records[i].month * 100 + day;
+  }
+}
+
+/*
+ * Return today's date as YYYYMMDD in local time, the same reference date
+ * `Personnummer::get_age` uses.
+ */
+std::int32_t today_yyyymmdd()
+{
+  std::time_t t = std::time(0);
+  std::tm *now = std::localtime(&t);
+
+  return (now->tm_year + 1900) * 10000 + (now->tm_mon + 1) * 100 +
+         now->tm_mday;
+}
+
+/*
+ * Calculate the age on the date `reference` for every birth date. The age is
+ * the difference between the dates divided by 10000, rounded down. With SSE2
+ * four ages are calculated at a time, dividing by multiplying with the
+ * reciprocal since there is no integer division instruction.
+ */
+void ages_at(const std::int32_t *birth_dates, std::size_t count,
+             std::int32_t reference, std::int32_t *ages)
+{
+  std::size_t i = 0;
+
+#ifdef PERSONNUMMER_SSE2
+  // floor(x / 10000) == (x * 3518437209) >> 45 for every 32 bit x.
+  const __m128i reciprocal = _mm_set1_epi32(static_cast<int>(3518437209u));
+  const __m128i biased = _mm_set1_epi32(reference + age_bias * 10000);
+  const __m128i bias = _mm_set1_epi32(age_bias);
+
+  for (; i + 4 <= count; i += 4)
+  {
+    __m128i dates =
+        _mm_loadu_si128(reinterpret_cast<const __m128i *>(birth_dates + i));
+    __m128i diff = _mm_sub_epi32(biased, dates);
+
+    __m128i even = _mm_srli_epi64(_mm_mul_epu32(diff, reciprocal), 45);
+    __m128i odd = _mm_srli_epi64(
+        _mm_mul_epu32(_mm_srli_epi64(diff, 32), reciprocal), 45);
+    __m128i years = _mm_or_si128(even, _mm_slli_epi64(odd, 32));
+
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(ages + i),
+                     _mm_sub_epi32(years, bias));
+  }
+#endif
+
+  for (; i < count; ++i)
+    ages[i] = age(birth_dates[i], reference);
+}
+
+/*
+ * Set bit `i % 64` of `mask[i / 64]` if birth date `i` belongs to someone who
+ * is at least `min_age` years old on `reference`. `mask` must have room for
+ * `(count + 63) / 64` words. Returns the number of set bits.
+ */
+std::size_t age_at_least(const std::int32_t *birth_dates, std::size_t count,
+                         std::int32_t reference, int min_age,
+                         std::uint64_t *mask)
+{
+  // Born on or before this date means old enough.
+  const std::int32_t cutoff = reference - min_age * 10000;
+  std::size_t matches = 0;
+
+  for (std::size_t word = 0; word * 64 < count; ++word)
+  {
+    std::size_t begin = word * 64;
+    std::size_t end = begin + 64 < count ? begin + 64 : count;
+    std::size_t i = begin;
+    std::uint64_t bits = 0;
+
+#ifdef PERSONNUMMER_SSE2
+    const __m128i limit = _mm_set1_epi32(cutoff);
+
+    for (; i + 4 <= end; i += 4)
+    {
+      __m128i dates =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(birth_dates + i));
+      __m128i too_young = _mm_cmpgt_epi32(dates, limit);
+      unsigned lanes =
+          ~static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(too_young)));
+
+      bits |= static_cast<std::uint64_t>(lanes & 0xf) << (i - begin);
+    }
+#endif
+
+    for (; i < end; ++i)
+    {
+      if (birth_dates[i] <= cutoff)
+        bits |= 1ULL << (i - begin);
+    }
+
+    mask[word] = bits;
+
+    for (; bits; bits &= bits - 1)
+      ++matches;
+  }
+
+  return matches;
+}
+
+// vim: set ts=2 sw=2 et:
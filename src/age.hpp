@@ -0,0 +1,30 @@
+#pragma once
+
+#include "personnummer.hpp"
+#include "personnummer_c.h"
+#include <cstddef>
+#include <cstdint>
+
+/*
+ * Age calculations over columns of birth dates. A birth date is stored as an
+ * integer on the form YYYYMMDD with the coordination number offset removed,
+ * which makes comparing dates a single integer comparison: someone born on `b`
+ * is at least `n` years old on `d` exactly when `b <= d - n * 10000`.
+ *
+ * Ages follow the same rules as `Personnummer::get_age`, counting from the
+ * actual day of birth for coordination numbers too.
+ */
+void birth_date_column(const Personnummer *pnrs, std::size_t count,
+                       std::int32_t *birth_dates);
+void birth_date_column(const pnr_record *records, std::size_t count,
+                       std::int32_t *birth_dates);
+
+std::int32_t today_yyyymmdd();
+
+void ages_at(const std::int32_t *birth_dates, std::size_t count,
+             std::int32_t reference, std::int32_t *ages);
+std::size_t age_at_least(const std::int32_t *birth_dates, std::size_t count,
+                         std::int32_t reference, int min_age,
+                         std::uint64_t *mask);
+
+// vim: set ts=2 sw=2 et:
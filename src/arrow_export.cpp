@@ -0,0 +1,223 @@
+#include "personnummer_arrow.h"
+#include "personnummer.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace
+{
+const int column_count = 5;
+
+const char *const column_names[column_count] = {"birth_date", "serial",
+                                                "control", "valid", "type"};
+const char *const column_formats[column_count] = {"tdD", "S", "C", "b", "C"};
+
+/*
+ * Everything an exported array points to, in one allocation shared by the
+ * struct array and its children. Each of them holds a reference and the last
+ * one released frees it, so a child moved out of the struct outlives it.
+ */
+struct ArrayExport
+{
+  std::atomic<int> references;
+  void *data;
+  const void *struct_buffers[1];
+  const void *child_buffers[column_count][2];
+  ArrowArray children[column_count];
+  ArrowArray *child_pointers[column_count];
+};
+
+struct SchemaExport
+{
+  std::atomic<int> references;
+  ArrowSchema children[column_count];
+  ArrowSchema *child_pointers[column_count];
+};
+
+std::size_t padded(std::size_t bytes)
+{
+  return (bytes + 63) & ~std::size_t(63);
+}
+
+void release_array(ArrowArray *array)
+{
+  ArrayExport *exported = static_cast<ArrayExport *>(array->private_data);
+
+  for (int64_t i = 0; i < array->n_children; ++i)
+  {
+    if (array->children[i]->release != nullptr)
+      array->children[i]->release(array->children[i]);
+  }
+
+  array->release = nullptr;
+
+  if (--exported->references == 0)
+  {
+    std::free(exported->data);
+    delete exported;
+  }
+}
+
+void release_schema(ArrowSchema *schema)
+{
+  SchemaExport *exported = static_cast<SchemaExport *>(schema->private_data);
+
+  for (int64_t i = 0; i < schema->n_children; ++i)
+  {
+    if (schema->children[i]->release != nullptr)
+      schema->children[i]->release(schema->children[i]);
+  }
+
+  schema->release = nullptr;
+
+  if (--exported->references == 0)
+    delete exported;
+}
+
+void set_bit(std::uint8_t *bitmap, std::size_t i)
+{
+  bitmap[i / 8] = static_cast<std::uint8_t>(bitmap[i / 8] | (1u << (i % 8)));
+}
+} // namespace
+
+/*
+ * The columns are written in one pass over the records into a single
+ * allocation, each column starting on a 64 byte boundary as Arrow recommends.
+ * Bitmaps are zeroed first since only set bits are written.
+ */
+int pnr_export_arrow(const pnr_record *records, size_t count,
+                     ArrowSchema *schema, ArrowArray *array)
+{
+  std::size_t bitmap_size = padded((count + 7) / 8);
+  std::size_t size = 3 * bitmap_size + padded(count * sizeof(std::int32_t)) +
+                     padded(count * sizeof(std::uint16_t)) +
+                     2 * padded(count) + 64;
+
+  ArrayExport *exported = new (std::nothrow) ArrayExport();
+  SchemaExport *exported_schema = new (std::nothrow) SchemaExport();
+  void *data = std::malloc(size);
+
+  if (exported == nullptr || exported_schema == nullptr || data == nullptr)
+  {
+    delete exported;
+    delete exported_schema;
+    std::free(data);
+    return 1;
+  }
+
+  std::uintptr_t at =
+      (reinterpret_cast<std::uintptr_t>(data) + 63) & ~std::uintptr_t(63);
+  std::uint8_t *well_formed = reinterpret_cast<std::uint8_t *>(at);
+  std::uint8_t *valid = well_formed + bitmap_size;
+  std::uint8_t *dated = valid + bitmap_size;
+  std::int32_t *birth_dates =
+      reinterpret_cast<std::int32_t *>(dated + bitmap_size);
+  std::uint16_t *serials = reinterpret_cast<std::uint16_t *>(
+      reinterpret_cast<std::uint8_t *>(birth_dates) +
+      padded(count * sizeof(std::int32_t)));
+  std::uint8_t *controls = reinterpret_cast<std::uint8_t *>(serials) +
+                           padded(count * sizeof(std::uint16_t));
+  std::uint8_t *types = controls + padded(count);
+  std::int64_t null_count = 0;
+  std::int64_t undated_count = 0;
+
+  std::memset(well_formed, 0, 3 * bitmap_size);
+
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    const pnr_record &record = records[i];
+
+    if (!(record.flags & PNR_WELL_FORMED))
+    {
+      birth_dates[i] = 0;
+      serials[i] = 0;
+      controls[i] = 0;
+      types[i] = 0;
+      ++null_count;
+      ++undated_count;
+      continue;
+    }
+
+    set_bit(well_formed, i);
+
+    if (record.flags & PNR_VALID)
+      set_bit(valid, i);
+
+    // Well formed numbers can still have a date like February 30.
+    int day = record.day % coordination_extra;
+
+    if (valid_date(record.year, record.month, day))
+    {
+      set_bit(dated, i);
+      birth_dates[i] = days_from_civil(record.year, record.month, day);
+    }
+    else
+    {
+      birth_dates[i] = 0;
+      ++undated_count;
+    }
+
+    serials[i] = record.serial;
+    controls[i] = record.control;
+    types[i] = record.flags & PNR_COORDINATION ? PNR_ARROW_COORDINATION
+                                               : PNR_ARROW_PERSONNUMMER;
+  }
+
+  const void *values[column_count] = {birth_dates, serials, controls, valid,
+                                      types};
+
+  exported->references = column_count + 1;
+  exported->data = data;
+  exported->struct_buffers[0] = well_formed;
+  exported_schema->references = column_count + 1;
+
+  for (int i = 0; i < column_count; ++i)
+  {
+    // The birth date, the first column, is the only one with nulls of its own.
+    ArrowArray &child = exported->children[i];
+    exported->child_buffers[i][0] = i == 0 ? dated : nullptr;
+    exported->child_buffers[i][1] = values[i];
+
+    child = ArrowArray();
+    child.length = static_cast<std::int64_t>(count);
+    child.null_count = i == 0 ? undated_count : 0;
+    child.n_buffers = 2;
+    child.buffers = exported->child_buffers[i];
+    child.release = release_array;
+    child.private_data = exported;
+    exported->child_pointers[i] = &child;
+
+    ArrowSchema &child_schema = exported_schema->children[i];
+    child_schema = ArrowSchema();
+    child_schema.format = column_formats[i];
+    child_schema.name = column_names[i];
+    child_schema.flags = i == 0 ? ARROW_FLAG_NULLABLE : 0;
+    child_schema.release = release_schema;
+    child_schema.private_data = exported_schema;
+    exported_schema->child_pointers[i] = &child_schema;
+  }
+
+  *array = ArrowArray();
+  array->length = static_cast<std::int64_t>(count);
+  array->null_count = null_count;
+  array->n_buffers = 1;
+  array->n_children = column_count;
+  array->buffers = exported->struct_buffers;
+  array->children = exported->child_pointers;
+  array->release = release_array;
+  array->private_data = exported;
+
+  *schema = ArrowSchema();
+  schema->format = "+s";
+  schema->name = "";
+  schema->flags = ARROW_FLAG_NULLABLE;
+  schema->n_children = column_count;
+  schema->children = exported_schema->child_pointers;
+  schema->release = release_schema;
+  schema->private_data = exported_schema;
+
+  return 0;
+}
+
+// vim: set ts=2 sw=2 et:
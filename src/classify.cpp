@@ -0,0 +1,117 @@
+#include "classify.hpp"
+#include "personnummer.hpp"
+
+namespace
+{
+int two_digits(const char *s) { return (s[0] - '0') * 10 + (s[1] - '0'); }
+
+// Organisation numbers have 20 or more in the month position so they never
+// collide with a personal identity number.
+const int organisation_min_month = 20;
+} // namespace
+
+/*
+ * Classify a personal identity number, coordination number or organisation
+ * number in a single pass. The digits are collected once, the control digit is
+ * computed once with the same `luhn` used by `Personnummer`, and the type is
+ * then decided from the month and day fields. Personal identity numbers are
+ * accepted and validated exactly like `Personnummer` does.
+ */
+Identity classify_identity(const char *data, std::size_t length)
+{
+  Identity identity = Identity();
+  char digits[12];
+  std::size_t count = 0;
+  std::size_t divider_at = 0;
+  char divider = 0;
+
+  for (std::size_t i = 0; i < length; ++i)
+  {
+    char c = data[i];
+
+    if (c >= '0' && c <= '9' && count < sizeof(digits))
+    {
+      digits[count++] = c;
+    }
+    else if ((c == '-' || c == '+') && divider == 0 && count > 0)
+    {
+      divider = c;
+      divider_at = count;
+    }
+    else
+    {
+      return identity;
+    }
+  }
+
+  // Same layouts as accepted by `PersonnummerView`, see `view.cpp`.
+  bool has_century;
+
+  if (divider != 0)
+  {
+    std::size_t trailing = count - divider_at;
+
+    if ((divider_at != 6 && divider_at != 8) ||
+        (trailing != 3 && trailing != 4))
+      return identity;
+
+    has_century = divider_at == 8;
+  }
+  else
+  {
+    if (count < 9)
+      return identity;
+
+    has_century = count > 10;
+  }
+
+  char *body = has_century ? digits + 2 : digits;
+  bool has_control = count - (has_century ? 2 : 0) == 10;
+
+  identity.month = two_digits(body + 2);
+  identity.number = two_digits(body + 6) * 10 + (body[8] - '0');
+  identity.control = has_control ? body[9] - '0' : 0;
+
+  if (identity.month >= organisation_min_month)
+  {
+    bool century_ok = !has_century || two_digits(digits) == 16;
+
+    if (!has_control || divider == '+' || !century_ok ||
+        luhn(body, body + 9) != identity.control)
+      return Identity();
+
+    for (int i = 0; i < 10; ++i)
+      identity.key = identity.key * 10 + (body[i] - '0');
+
+    identity.month = 0;
+    identity.type = IdentityType::organisationsnummer;
+
+    return identity;
+  }
+
+  identity.year = (has_century ? two_digits(digits) : 19) * 100 +
+                  two_digits(body);
+  identity.day = two_digits(body + 4);
+  identity.key = static_cast<std::uint64_t>(identity.year) * 100000000ULL +
+                 static_cast<std::uint64_t>(identity.month) * 1000000ULL +
+                 static_cast<std::uint64_t>(identity.day) * 10000ULL +
+                 static_cast<std::uint64_t>(identity.number) * 10ULL +
+                 static_cast<std::uint64_t>(identity.control);
+
+  // Like `Personnummer` the control digit of a coordination number is
+  // calculated on the actual day of birth.
+  int day = identity.day % coordination_extra;
+  body[4] = static_cast<char>('0' + day / 10);
+  body[5] = static_cast<char>('0' + day % 10);
+
+  if (!valid_date(identity.year, identity.month, day) ||
+      identity.number <= 0 || luhn(body, body + 9) != identity.control)
+    return Identity();
+
+  identity.type = identity.day > 31 ? IdentityType::samordningsnummer
+                                    : IdentityType::personnummer;
+
+  return identity;
+}
+
+// vim: set ts=2 sw=2 et:
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+enum class IdentityType
+{
+  invalid,
+  personnummer,
+  samordningsnummer,
+  organisationsnummer,
+};
+
+/*
+ * The result of classifying an identity number. For personal and coordination
+ * numbers the date fields are set and `key` is the same as
+ * `Personnummer::canonical_key`. For organisation numbers only `number` (the
+ * three digits before the control digit), `control` and `key` (the ten digit
+ * number) are set. Everything is zero for invalid input.
+ */
+struct Identity
+{
+  IdentityType type;
+  int year;
+  int month;
+  int day;
+  int number;
+  int control;
+  std::uint64_t key;
+};
+
+Identity classify_identity(const char *data, std::size_t length);
+inline Identity classify_identity(const std::string &input)
+{
+  return classify_identity(input.data(), input.size());
+}
+
+// vim: set ts=2 sw=2 et:
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+
+// Length of a body (YYMMDDNNN) and of a body followed by its control digit.
+const std::size_t body_length = 9;
+const std::size_t completed_length = 10;
+
+/*
+ * Append the control digit to `n` bodies stored back to back in `in`. Each
+ * body is copied to `out` followed by its control digit, so `out` must have
+ * room for `n * completed_length` characters. Control digits are calculated
+ * like `Personnummer` does, on the actual day of birth for coordination
+ * numbers. A body with anything but digits gets '?' as control digit.
+ *
+ * Returns the number of bodies that were completed.
+ */
+std::size_t complete_control(const char *in, std::size_t n, char *out);
+
+// vim: set ts=2 sw=2 et:
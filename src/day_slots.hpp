@@ -0,0 +1,20 @@
+#pragma once
+
+#include "personnummer.hpp"
+#include <cstdint>
+
+// Days 1-31 and coordination days 61-91 map to 62 slots per month, which packs
+// dates densely for sets indexed by date.
+const std::uint64_t day_slots = 62;
+
+inline std::uint64_t day_slot(std::uint64_t day)
+{
+  return day > 31 ? day - coordination_extra + 30 : day - 1;
+}
+
+inline std::uint64_t slot_day(std::uint64_t slot)
+{
+  return slot < 31 ? slot + 1 : slot - 30 + coordination_extra;
+}
+
+// vim: set ts=2 sw=2 et:
@@ -0,0 +1,106 @@
+#include "dedupe.hpp"
+#include "day_slots.hpp"
+
+namespace
+{
+const std::uint64_t serials_per_day = 1000;
+const std::uint64_t bits_per_year = 12 * day_slots * serials_per_day;
+
+int popcount(std::uint64_t x)
+{
+  int count = 0;
+
+  for (; x; x &= x - 1)
+    ++count;
+
+  return count;
+}
+} // namespace
+
+PersonnummerSet::PersonnummerSet(int first_year, int last_year)
+    : first_year(first_year), last_year(last_year < first_year ? first_year - 1
+                                                               : last_year),
+      words(static_cast<std::size_t>(
+          ((this->last_year - first_year + 1) * bits_per_year + 63) / 64)),
+      bits(new std::atomic<std::uint64_t>[words]())
+{
+}
+
+/*
+ * Map a personal identity number to its position in the bitmap. Returns false
+ * if the number isn't valid or if the birth year is outside of the range the
+ * set was created for.
+ */
+bool PersonnummerSet::bit_index(const Personnummer &pnr,
+                                std::uint64_t &index) const
+{
+  if (!pnr.valid())
+    return false;
+
+  std::uint64_t key = pnr.canonical_key();
+  int year = static_cast<int>(key / 100000000);
+
+  if (year < first_year || year > last_year)
+    return false;
+
+  std::uint64_t month = (key / 1000000) % 100 - 1;
+  std::uint64_t day = (key / 10000) % 100;
+  std::uint64_t number = (key / 10) % 1000;
+
+  index = static_cast<std::uint64_t>(year - first_year) * bits_per_year +
+          (month * day_slots + day_slot(day)) * serials_per_day + number;
+
+  return true;
+}
+
+/*
+ * Add the number to the set. Returns true if the number wasn't already in the
+ * set, false if it was or if it can't be stored (invalid or out of range).
+ */
+bool PersonnummerSet::insert(const Personnummer &pnr)
+{
+  std::uint64_t index;
+
+  if (!bit_index(pnr, index))
+    return false;
+
+  std::uint64_t mask = 1ULL << (index % 64);
+  std::uint64_t old =
+      bits[index / 64].fetch_or(mask, std::memory_order_relaxed);
+
+  return (old & mask) == 0;
+}
+
+bool PersonnummerSet::contains(const Personnummer &pnr) const
+{
+  std::uint64_t index;
+
+  if (!bit_index(pnr, index))
+    return false;
+
+  std::uint64_t mask = 1ULL << (index % 64);
+
+  return (bits[index / 64].load(std::memory_order_relaxed) & mask) != 0;
+}
+
+/*
+ * Count the numbers in the set. This walks the whole bitmap so it's meant to
+ * be used for reporting and not on a hot path.
+ */
+std::size_t PersonnummerSet::size() const
+{
+  std::size_t count = 0;
+
+  for (std::size_t i = 0; i < words; ++i)
+    count += popcount(bits[i].load(std::memory_order_relaxed));
+
+  return count;
+}
+
+void PersonnummerSet::clear()
+{
+  for (std::size_t i = 0; i < words; ++i)
+    bits[i].store(0, std::memory_order_relaxed);
+}
+
+// vim: set ts=2 sw=2 et:
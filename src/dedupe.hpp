@@ -0,0 +1,37 @@
+#pragma once
+
+#include "personnummer.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/*
+ * A set of valid personal identity numbers backed by one bit per possible
+ * number. Since the control digit is given by the other digits a valid number
+ * is identified by its date and serial number alone, and the dense key space
+ * fits in about 93 kB per birth year (including coordination numbers).
+ *
+ * Inserts and lookups are lock free and can be done concurrently from any
+ * number of threads.
+ */
+class PersonnummerSet
+{
+  int first_year;
+  int last_year;
+  std::size_t words;
+  std::unique_ptr<std::atomic<std::uint64_t>[]> bits;
+
+  bool bit_index(const Personnummer &pnr, std::uint64_t &index) const;
+
+public:
+  PersonnummerSet(int first_year = 1800, int last_year = 2199);
+
+  bool insert(const Personnummer &pnr);
+  bool contains(const Personnummer &pnr) const;
+  std::size_t size() const;
+  std::size_t memory_usage() const { return words * sizeof(std::uint64_t); }
+  void clear();
+};
+
+// vim: set ts=2 sw=2 et:
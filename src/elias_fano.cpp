@@ -0,0 +1,528 @@
+#include "elias_fano.hpp"
+#include "day_slots.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+const char set_magic[8] = {'P', 'N', 'R', 'E', 'F', 'S', 'E', 'T'};
+const std::uint32_t set_version = 2;
+const std::uint32_t set_byte_order = 0x01020304;
+
+// Every this many buckets the position where the bucket starts is sampled.
+const std::uint64_t sample_interval = 256;
+
+struct SetHeader
+{
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t byte_order;
+  std::uint64_t count;
+  std::uint64_t low_bits;
+  std::uint64_t low_words;
+  std::uint64_t upper_words;
+  std::uint64_t sample_count;
+  std::uint64_t max_key;
+  std::uint64_t base_year;
+};
+
+/*
+ * Keys are stored in a compact form where each month has `day_slots` day
+ * slots, for the regular days and the coordination number days, instead of
+ * 100, and years are counted from the first year in the set. Without this the
+ * keys would be spread very unevenly over the range of possible keys, lookups
+ * would have to scan long runs of keys in the busy parts of the range and a
+ * larger range would need more low bits per key.
+ */
+std::uint64_t compact(std::uint64_t year, std::uint64_t month,
+                      std::uint64_t day, std::uint64_t rest)
+{
+  return ((year * 12 + month - 1) * day_slots + day_slot(day)) * 10000 + rest;
+}
+
+bool representable(std::uint64_t month, std::uint64_t day)
+{
+  return month >= 1 && month <= 12 &&
+         ((day >= 1 && day <= 31) || (day >= 61 && day <= 91));
+}
+
+bool compact_key(std::uint64_t key, std::uint64_t base_year,
+                 std::uint64_t &compacted)
+{
+  std::uint64_t year = key / 100000000;
+  std::uint64_t month = key / 1000000 % 100;
+  std::uint64_t day = key / 10000 % 100;
+
+  if (key >= 1000000000000ULL || year < base_year ||
+      !representable(month, day))
+    return false;
+
+  compacted = compact(year - base_year, month, day, key % 10000);
+
+  return true;
+}
+
+/*
+ * Return the compact form of the smallest key that can be stored and isn't
+ * less than `key`. Since compacting keeps the order this gives the rank of
+ * keys that can't be stored themselves.
+ */
+std::uint64_t next_compact_key(std::uint64_t key, std::uint64_t base_year)
+{
+  std::uint64_t year = key / 100000000;
+  std::uint64_t month = key / 1000000 % 100;
+  std::uint64_t day = key / 10000 % 100;
+  std::uint64_t rest = key % 10000;
+
+  if (year < base_year)
+    return 0;
+
+  if (month == 0 || month > 12)
+  {
+    year += month > 12 ? 1 : 0;
+    month = 1;
+    day = 1;
+    rest = 0;
+  }
+
+  if (day == 0 || (day > 31 && day < 61))
+  {
+    day = day == 0 ? 1 : 61;
+    rest = 0;
+  }
+  else if (day > 91)
+  {
+    year += month == 12 ? 1 : 0;
+    month = month == 12 ? 1 : month + 1;
+    day = 1;
+    rest = 0;
+  }
+
+  return compact(year - base_year, month, day, rest);
+}
+
+std::uint64_t expand_key(std::uint64_t compacted, std::uint64_t base_year)
+{
+  std::uint64_t rest = compacted % 10000;
+  std::uint64_t day = slot_day(compacted / 10000 % day_slots);
+  std::uint64_t months = compacted / 10000 / day_slots;
+
+  return (base_year + months / 12) * 100000000ULL +
+         (months % 12 + 1) * 1000000ULL + day * 10000ULL + rest;
+}
+
+int popcount(std::uint64_t x)
+{
+#if defined(__GNUC__)
+  return __builtin_popcountll(x);
+#else
+  int count = 0;
+
+  for (; x; x &= x - 1)
+    ++count;
+
+  return count;
+#endif
+}
+
+int lowest_bit(std::uint64_t x)
+{
+#if defined(__GNUC__)
+  return __builtin_ctzll(x);
+#else
+  int bit = 0;
+
+  for (; (x & 1) == 0; x >>= 1)
+    ++bit;
+
+  return bit;
+#endif
+}
+} // namespace
+
+void EliasFanoSet::reset()
+{
+  storage.clear();
+  file.close();
+  low = upper = samples = nullptr;
+  count = 0;
+  low_bits = 0;
+  low_words = upper_words = sample_count = 0;
+  max_key = 0;
+  base_year = 0;
+}
+
+/*
+ * Encode the keys, replacing the current content. The keys don't have to be
+ * sorted or unique. Keys with a month or day that no personal identity number
+ * can have are left out.
+ */
+void EliasFanoSet::build(const std::vector<std::uint64_t> &canonical_keys)
+{
+  reset();
+
+  std::vector<std::uint64_t> keys;
+  keys.reserve(canonical_keys.size());
+  base_year = ~0ULL;
+
+  for (std::uint64_t key : canonical_keys)
+  {
+    std::uint64_t unused;
+
+    if (compact_key(key, 0, unused))
+      base_year = std::min(base_year, key / 100000000);
+  }
+
+  for (std::uint64_t key : canonical_keys)
+  {
+    std::uint64_t compacted;
+
+    if (compact_key(key, base_year, compacted))
+      keys.push_back(compacted);
+  }
+
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+  if (keys.empty())
+  {
+    base_year = 0;
+    return;
+  }
+
+  count = keys.size();
+  max_key = keys.back();
+
+  // Split so the high part of the keys take about two bits per key.
+  while (low_bits < 63 && (max_key >> (low_bits + 1)) >= count)
+    ++low_bits;
+
+  std::uint64_t buckets = (max_key >> low_bits) + 1;
+  std::size_t upper_size = count + buckets;
+
+  low_words = (count * low_bits + 63) / 64;
+  upper_words = (upper_size + 63) / 64;
+  sample_count = (buckets + sample_interval - 1) / sample_interval;
+  storage.assign(low_words + upper_words + sample_count, 0);
+
+  std::uint64_t *low_out = storage.data();
+  std::uint64_t *upper_out = low_out + low_words;
+  std::uint64_t *samples_out = upper_out + upper_words;
+  std::uint64_t low_mask = low_bits ? (~0ULL >> (64 - low_bits)) : 0;
+
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    std::uint64_t value = keys[i] & low_mask;
+    std::size_t bit = i * low_bits;
+
+    if (low_bits > 0)
+    {
+      low_out[bit / 64] |= value << (bit % 64);
+
+      if (bit % 64 + low_bits > 64)
+        low_out[bit / 64 + 1] |= value >> (64 - bit % 64);
+    }
+
+    std::size_t position = (keys[i] >> low_bits) + i;
+    upper_out[position / 64] |= 1ULL << (position % 64);
+  }
+
+  // Bucket b starts right after the b:th zero in the upper bits.
+  std::uint64_t zeros = 0;
+
+  for (std::size_t position = 0; position < upper_size; ++position)
+  {
+    if (zeros % sample_interval == 0 && zeros / sample_interval < sample_count &&
+        (position == 0 || ((upper_out[(position - 1) / 64] >>
+                            ((position - 1) % 64)) & 1) == 0))
+      samples_out[zeros / sample_interval] = position;
+
+    if (((upper_out[position / 64] >> (position % 64)) & 1) == 0)
+      ++zeros;
+  }
+
+  low = low_out;
+  upper = upper_out;
+  samples = samples_out;
+}
+
+bool EliasFanoSet::write(const std::string &path) const
+{
+  SetHeader header;
+  std::memcpy(header.magic, set_magic, sizeof(header.magic));
+  header.version = set_version;
+  header.byte_order = set_byte_order;
+  header.count = count;
+  header.low_bits = low_bits;
+  header.low_words = low_words;
+  header.upper_words = upper_words;
+  header.sample_count = sample_count;
+  header.max_key = max_key;
+  header.base_year = base_year;
+
+  std::FILE *out = std::fopen(path.c_str(), "wb");
+
+  if (out == nullptr)
+    return false;
+
+  bool ok =
+      std::fwrite(&header, sizeof(header), 1, out) == 1 &&
+      std::fwrite(low, sizeof(std::uint64_t), low_words, out) == low_words &&
+      std::fwrite(upper, sizeof(std::uint64_t), upper_words, out) ==
+          upper_words &&
+      std::fwrite(samples, sizeof(std::uint64_t), sample_count, out) ==
+          sample_count;
+
+  return std::fclose(out) == 0 && ok;
+}
+
+/*
+ * Open a set written by `write`. The file is memory mapped and used as is.
+ * Returns false, leaving the set empty, if the file is missing, truncated or
+ * written by a different version or on a host with a different byte order.
+ *
+ * Lookups trust the sizes in the header and the upper bits to stay within the
+ * file, so these are checked against each other first: the word counts must be
+ * the ones `build` gives for `count`, `low_bits` and `max_key`, the upper bits
+ * must hold exactly `count` ones ending with a zero and every sample must be
+ * the start of its bucket, so `bucket_start` always finds its zero.
+ */
+bool EliasFanoSet::open(const std::string &path)
+{
+  reset();
+
+  if (!file.open(path) || file.size() < sizeof(SetHeader))
+  {
+    reset();
+    return false;
+  }
+
+  SetHeader header;
+  std::memcpy(&header, file.data(), sizeof(header));
+
+  std::uint64_t words = (file.size() - sizeof(header)) / sizeof(std::uint64_t);
+  std::uint64_t buckets =
+      header.low_bits > 63 ? 0 : (header.max_key >> header.low_bits) + 1;
+
+  if (std::memcmp(header.magic, set_magic, sizeof(header.magic)) != 0 ||
+      header.version != set_version || header.byte_order != set_byte_order ||
+      header.low_bits > 63 || header.count > words * 64 ||
+      buckets > words * 64 ||
+      header.low_words != (header.count * header.low_bits + 63) / 64 ||
+      (header.count > 0 &&
+       (header.upper_words != (header.count + buckets + 63) / 64 ||
+        header.sample_count !=
+            (buckets + sample_interval - 1) / sample_interval)) ||
+      (header.count == 0 &&
+       header.upper_words + header.sample_count + header.max_key != 0) ||
+      words < header.low_words + header.upper_words + header.sample_count)
+  {
+    reset();
+    return false;
+  }
+
+  const std::uint64_t *data =
+      reinterpret_cast<const std::uint64_t *>(file.data() + sizeof(header));
+  const std::uint64_t *upper_in = data + header.low_words;
+  const std::uint64_t *samples_in = upper_in + header.upper_words;
+  std::uint64_t upper_size = header.count > 0 ? header.count + buckets : 0;
+  std::uint64_t ones = 0;
+
+  for (std::uint64_t i = 0; i < header.upper_words; ++i)
+    ones += popcount(upper_in[i]);
+
+  bool consistent =
+      ones == header.count &&
+      (upper_size == 0 ||
+       (upper_in[(upper_size - 1) / 64] >> ((upper_size - 1) % 64)) == 0);
+
+  // Count the zeros again and check each sample against the position `build`
+  // gives it, right after the zero that ends the bucket before it.
+  std::uint64_t zeros = 0;
+  consistent =
+      consistent && (header.sample_count == 0 || samples_in[0] == 0);
+
+  for (std::uint64_t word = 0; consistent && word < header.upper_words; ++word)
+  {
+    std::uint64_t free_bits = ~upper_in[word];
+
+    if ((word + 1) * 64 > upper_size)
+      free_bits &= ~0ULL >> ((word + 1) * 64 - upper_size);
+
+    while (consistent && free_bits != 0)
+    {
+      std::uint64_t next = (zeros / sample_interval + 1) * sample_interval;
+      int available = popcount(free_bits);
+
+      if (zeros + available < next)
+      {
+        zeros += available;
+        break;
+      }
+
+      for (; zeros + 1 < next; ++zeros)
+        free_bits &= free_bits - 1;
+
+      std::uint64_t sample = next / sample_interval;
+      consistent = sample >= header.sample_count ||
+                   samples_in[sample] == word * 64 + lowest_bit(free_bits) + 1;
+      free_bits &= free_bits - 1;
+      ++zeros;
+    }
+  }
+
+  if (!consistent)
+  {
+    reset();
+    return false;
+  }
+
+  count = static_cast<std::size_t>(header.count);
+  low_bits = static_cast<unsigned>(header.low_bits);
+  low_words = static_cast<std::size_t>(header.low_words);
+  upper_words = static_cast<std::size_t>(header.upper_words);
+  sample_count = static_cast<std::size_t>(header.sample_count);
+  max_key = header.max_key;
+  base_year = header.base_year;
+  low = data;
+  upper = upper_in;
+  samples = samples_in;
+
+  return true;
+}
+
+std::uint64_t EliasFanoSet::low_value(std::size_t i) const
+{
+  if (low_bits == 0)
+    return 0;
+
+  std::size_t bit = i * low_bits;
+  std::uint64_t value = low[bit / 64] >> (bit % 64);
+
+  if (bit % 64 + low_bits > 64)
+    value |= low[bit / 64 + 1] << (64 - bit % 64);
+
+  return value & (~0ULL >> (64 - low_bits));
+}
+
+/*
+ * Return the position in the upper bits where `bucket` starts, which is right
+ * after the bucket:th zero. Starts at the closest sample and counts zeros a
+ * word at a time from there.
+ */
+std::size_t EliasFanoSet::bucket_start(std::uint64_t bucket) const
+{
+  std::size_t position = samples[bucket / sample_interval];
+  std::uint64_t zeros = bucket % sample_interval;
+
+  while (zeros > 0)
+  {
+    std::size_t word = position / 64;
+    std::uint64_t free_bits = ~upper[word] & (~0ULL << (position % 64));
+    int available = popcount(free_bits);
+
+    if (static_cast<std::uint64_t>(available) < zeros)
+    {
+      zeros -= available;
+      position = (word + 1) * 64;
+      continue;
+    }
+
+    // The wanted zero is in this word, drop the zeros before it.
+    for (; zeros > 1; --zeros)
+      free_bits &= free_bits - 1;
+
+    return word * 64 + lowest_bit(free_bits) + 1;
+  }
+
+  return position;
+}
+
+/*
+ * Return the index of the first key that is not less than `key` and set
+ * `found` if it's equal to `key`.
+ */
+std::size_t EliasFanoSet::find(std::uint64_t key, bool &found) const
+{
+  found = false;
+
+  if (count == 0 || key > max_key)
+    return count;
+
+  std::uint64_t bucket = key >> low_bits;
+  std::uint64_t low_key = key & (low_bits ? ~0ULL >> (64 - low_bits) : 0);
+  std::size_t position = bucket_start(bucket);
+  std::size_t index = position - bucket;
+
+  for (; upper_bit(position); ++position, ++index)
+  {
+    std::uint64_t value = low_value(index);
+
+    if (value >= low_key)
+    {
+      found = value == low_key;
+      break;
+    }
+  }
+
+  return index;
+}
+
+bool EliasFanoSet::contains(std::uint64_t key) const
+{
+  std::uint64_t compacted;
+  bool found = false;
+
+  if (compact_key(key, base_year, compacted))
+    find(compacted, found);
+
+  return found;
+}
+
+/*
+ * Return the number of keys in the set that are less than `key`.
+ */
+std::size_t EliasFanoSet::rank(std::uint64_t key) const
+{
+  bool found;
+
+  return find(next_compact_key(key, base_year), found);
+}
+
+EliasFanoSet::iterator::iterator(const EliasFanoSet *set, std::size_t index)
+    : set(set), index(index), position(0)
+{
+  if (index < set->count)
+  {
+    position = set->bucket_start(0);
+    skip_zeros();
+  }
+}
+
+void EliasFanoSet::iterator::skip_zeros()
+{
+  while (!set->upper_bit(position))
+    ++position;
+}
+
+std::uint64_t EliasFanoSet::iterator::operator*() const
+{
+  std::uint64_t high = position - index;
+
+  return expand_key(high << set->low_bits | set->low_value(index),
+                    set->base_year);
+}
+
+EliasFanoSet::iterator &EliasFanoSet::iterator::operator++()
+{
+  if (++index < set->count)
+  {
+    ++position;
+    skip_zeros();
+  }
+
+  return *this;
+}
+
+// vim: set ts=2 sw=2 et:
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "mapped_file.hpp"
+#include "personnummer.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <string>
+#include <vector>
+
+/*
+ * A compressed sorted set of canonical keys using Elias-Fano encoding. Each key
+ * is split into low bits, stored as is, and high bits, stored as a unary coded
+ * gap in a bitvector. Storing n keys from a universe of U values takes at most
+ * 2 + ceil(log2(U / n)) bits per key. Keys are packed so U is about 7.4 million
+ * per year between the first and the last birth year in the set; a registry of
+ * 10 million numbers born over 120 years takes about 9 bits per number. A
+ * sample of every 256th bucket start makes `contains` and `rank` jump close to
+ * the right position before scanning.
+ *
+ * A set can be built in memory, written to a file and opened again with mmap.
+ */
+class EliasFanoSet
+{
+  std::vector<std::uint64_t> storage;
+  MappedFile file;
+  const std::uint64_t *low;
+  const std::uint64_t *upper;
+  const std::uint64_t *samples;
+  std::size_t count;
+  unsigned low_bits;
+  std::size_t low_words;
+  std::size_t upper_words;
+  std::size_t sample_count;
+  std::uint64_t max_key;
+  std::uint64_t base_year;
+
+  EliasFanoSet(const EliasFanoSet &) = delete;
+  EliasFanoSet &operator=(const EliasFanoSet &) = delete;
+
+  std::uint64_t low_value(std::size_t i) const;
+  bool upper_bit(std::size_t pos) const
+  {
+    return (upper[pos / 64] >> (pos % 64)) & 1;
+  }
+  std::size_t bucket_start(std::uint64_t bucket) const;
+  std::size_t find(std::uint64_t key, bool &found) const;
+  void reset();
+
+public:
+  class iterator
+  {
+    const EliasFanoSet *set;
+    std::size_t index;
+    std::size_t position;
+
+    // Only `begin` and `end` are set up, other indexes would need a select.
+    iterator(const EliasFanoSet *set, std::size_t index);
+    void skip_zeros();
+
+    friend class EliasFanoSet;
+
+  public:
+    typedef std::forward_iterator_tag iterator_category;
+    typedef std::uint64_t value_type;
+    typedef std::ptrdiff_t difference_type;
+    typedef const std::uint64_t *pointer;
+    typedef std::uint64_t reference;
+
+    std::uint64_t operator*() const;
+    iterator &operator++();
+    bool operator==(const iterator &other) const
+    {
+      return index == other.index;
+    }
+    bool operator!=(const iterator &other) const
+    {
+      return index != other.index;
+    }
+  };
+
+  EliasFanoSet() { reset(); }
+
+  void build(const std::vector<std::uint64_t> &canonical_keys);
+  bool write(const std::string &path) const;
+  bool open(const std::string &path);
+
+  std::size_t size() const { return count; }
+  std::size_t memory_usage() const
+  {
+    return (low_words + upper_words + sample_count) * sizeof(std::uint64_t);
+  }
+
+  bool contains(std::uint64_t key) const;
+  bool contains(const Personnummer &pnr) const
+  {
+    return contains(pnr.canonical_key());
+  }
+  std::size_t rank(std::uint64_t key) const;
+
+  iterator begin() const { return iterator(this, 0); }
+  iterator end() const { return iterator(this, count); }
+};
+
+// vim: set ts=2 sw=2 et:
@@ -0,0 +1,55 @@
+#include "format_arena.hpp"
+#include <algorithm>
+#include <cstring>
+
+/*
+ * Make room for at least `needed` bytes, at least doubling the capacity so
+ * appending batch after batch copies each byte a bounded number of times.
+ */
+void FormatArena::grow(std::size_t needed)
+{
+  std::size_t grown = std::max(needed, 2 * capacity);
+  std::unique_ptr<char[]> larger(new char[grown]);
+
+  if (used > 0)
+    std::memcpy(larger.get(), slab.get(), used);
+
+  slab = std::move(larger);
+  capacity = grown;
+}
+
+/*
+ * Format `count` numbers and add them to the arena. Returns the index of the
+ * first added number.
+ */
+std::size_t FormatArena::append(const Personnummer *pnrs, std::size_t count,
+                                bool long_format)
+{
+  std::size_t first = spans.size();
+  std::size_t needed = used + count * max_formatted_length;
+
+  // Room for the whole batch at its longest, only what is written is used.
+  if (needed > capacity)
+    grow(needed);
+
+  spans.resize(first + count);
+
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    std::size_t length = pnrs[i].format_to(slab.get() + used, long_format);
+
+    spans[first + i].offset = used;
+    spans[first + i].length = static_cast<std::uint32_t>(length);
+    used += length;
+  }
+
+  return first;
+}
+
+void FormatArena::clear()
+{
+  used = 0;
+  spans.clear();
+}
+
+// vim: set ts=2 sw=2 et:
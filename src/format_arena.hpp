@@ -0,0 +1,56 @@
+#pragma once
+
+#include "personnummer.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * Where a formatted number is stored in a `FormatArena`. The offset is 64 bits
+ * since a registry sized batch formats to more than 4 GiB of text.
+ */
+struct FormattedSpan
+{
+  std::uint64_t offset;
+  std::uint32_t length;
+};
+
+/*
+ * Formats batches of numbers into one contiguous buffer instead of one string
+ * per number. Numbers are referred to by offset and length so they stay valid
+ * when the buffer grows. `clear()` releases everything at once but keeps the
+ * memory, so formatting batches of the same size again doesn't allocate.
+ */
+class FormatArena
+{
+  // Not a vector, growing it would zero the bytes about to be overwritten.
+  std::unique_ptr<char[]> slab;
+  std::size_t used;
+  std::size_t capacity;
+  std::vector<FormattedSpan> spans;
+
+  void grow(std::size_t needed);
+
+public:
+  FormatArena() : used(0), capacity(0) {}
+
+  std::size_t append(const Personnummer *pnrs, std::size_t count,
+                     bool long_format = false);
+  void clear();
+
+  std::size_t size() const { return spans.size(); }
+  const char *data() const { return slab.get(); }
+  const FormattedSpan &operator[](std::size_t i) const { return spans[i]; }
+  const char *begin(std::size_t i) const
+  {
+    return slab.get() + spans[i].offset;
+  }
+  std::string str(std::size_t i) const
+  {
+    return std::string(begin(i), spans[i].length);
+  }
+};
+
+// vim: set ts=2 sw=2 et:
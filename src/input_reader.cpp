@@ -0,0 +1,496 @@
+#include "input_reader.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#define PERSONNUMMER_IO_URING
+#endif
+#endif
+#endif
+
+namespace
+{
+const char *const backend_names[] = {"stdio", "read", "pread", "mmap",
+                                     "io_uring"};
+
+#ifndef _WIN32
+bool regular_file(int fd, std::size_t &size)
+{
+  struct stat st;
+
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+    return false;
+
+  size = static_cast<std::size_t>(st.st_size);
+
+  return true;
+}
+#endif
+} // namespace
+
+const char *backend_name(InputBackend backend)
+{
+  return backend_names[static_cast<int>(backend)];
+}
+
+bool parse_backend(const char *name, InputBackend &backend)
+{
+  for (int i = 0; i < 5; ++i)
+  {
+    if (std::strcmp(name, backend_names[i]) == 0)
+    {
+      backend = static_cast<InputBackend>(i);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+#ifdef PERSONNUMMER_IO_URING
+/*
+ * A minimal io_uring with one read in flight per block. Blocks are filled
+ * from consecutive offsets and consumed in order; a consumed block is reused
+ * for the read `depth` blocks ahead.
+ */
+struct InputReader::Ring
+{
+  struct Block
+  {
+    std::vector<char> data;
+    iovec iov;
+    std::uint64_t offset;
+    std::size_t filled;
+    bool done;
+    bool failed;
+  };
+
+  int ring_fd;
+  int file_fd;
+  void *sq_map;
+  std::size_t sq_map_size;
+  void *cq_map;
+  std::size_t cq_map_size;
+  io_uring_sqe *sqes;
+  std::size_t sqes_size;
+  unsigned *sq_tail;
+  unsigned *sq_mask;
+  unsigned *sq_array;
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned *cq_mask;
+  io_uring_cqe *cqes;
+
+  std::vector<Block> blocks;
+  std::size_t block_size;
+  std::uint64_t next_block;
+  std::size_t consumed;
+  std::size_t in_flight;
+  bool end;
+
+  Ring()
+      : ring_fd(-1), sq_map(MAP_FAILED), cq_map(MAP_FAILED),
+        sqes(static_cast<io_uring_sqe *>(MAP_FAILED)), next_block(0),
+        consumed(0), in_flight(0), end(false)
+  {
+  }
+
+  ~Ring()
+  {
+    // The kernel writes to the blocks until their reads complete.
+    while (in_flight > 0 && wait())
+      ;
+
+    if (sqes != MAP_FAILED)
+      munmap(sqes, sqes_size);
+
+    if (cq_map != MAP_FAILED && cq_map != sq_map)
+      munmap(cq_map, cq_map_size);
+
+    if (sq_map != MAP_FAILED)
+      munmap(sq_map, sq_map_size);
+
+    if (ring_fd >= 0)
+      close(ring_fd);
+  }
+
+  bool setup(int fd, std::uint64_t start, std::size_t size, unsigned depth);
+  bool submit(std::size_t slot);
+  bool wait();
+  void reap();
+};
+
+bool InputReader::Ring::setup(int fd, std::uint64_t start, std::size_t size,
+                              unsigned depth)
+{
+  io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+
+  ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, depth, &params));
+
+  if (ring_fd < 0)
+    return false;
+
+  sq_map_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_map_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+  if (params.features & IORING_FEAT_SINGLE_MMAP)
+    sq_map_size = cq_map_size = std::max(sq_map_size, cq_map_size);
+
+  sq_map = mmap(nullptr, sq_map_size, PROT_READ | PROT_WRITE,
+                MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+
+  if (sq_map == MAP_FAILED)
+    return false;
+
+  cq_map = params.features & IORING_FEAT_SINGLE_MMAP
+               ? sq_map
+               : mmap(nullptr, cq_map_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+  sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+  sqes = static_cast<io_uring_sqe *>(mmap(nullptr, sqes_size,
+                                          PROT_READ | PROT_WRITE,
+                                          MAP_SHARED | MAP_POPULATE, ring_fd,
+                                          IORING_OFF_SQES));
+
+  if (cq_map == MAP_FAILED || sqes == MAP_FAILED)
+    return false;
+
+  char *sq = static_cast<char *>(sq_map);
+  char *cq = static_cast<char *>(cq_map);
+  sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  sq_mask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+  cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  cq_mask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+  file_fd = fd;
+  block_size = size;
+  blocks.resize(depth);
+
+  for (std::size_t slot = 0; slot < blocks.size(); ++slot)
+  {
+    blocks[slot].data.resize(block_size);
+    blocks[slot].offset = start + slot * block_size;
+    blocks[slot].filled = 0;
+    blocks[slot].done = blocks[slot].failed = false;
+
+    if (!submit(slot))
+      return false;
+  }
+
+  return true;
+}
+
+/*
+ * Queue a read of the rest of the block in `slot`.
+ */
+bool InputReader::Ring::submit(std::size_t slot)
+{
+  Block &block = blocks[slot];
+  block.iov.iov_base = block.data.data() + block.filled;
+  block.iov.iov_len = block_size - block.filled;
+
+  unsigned tail = *sq_tail;
+  unsigned index = tail & *sq_mask;
+  io_uring_sqe &sqe = sqes[index];
+
+  std::memset(&sqe, 0, sizeof(sqe));
+  sqe.opcode = IORING_OP_READV;
+  sqe.fd = file_fd;
+  sqe.off = block.offset + block.filled;
+  sqe.addr = reinterpret_cast<std::uint64_t>(&block.iov);
+  sqe.len = 1;
+  sqe.user_data = slot;
+  sq_array[index] = index;
+  __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+  if (syscall(__NR_io_uring_enter, ring_fd, 1, 0, 0, nullptr, 0) != 1)
+    return false;
+
+  ++in_flight;
+
+  return true;
+}
+
+/*
+ * Wait for at least one read to complete and handle all that have.
+ */
+bool InputReader::Ring::wait()
+{
+  if (syscall(__NR_io_uring_enter, ring_fd, 0, 1, IORING_ENTER_GETEVENTS,
+              nullptr, 0) < 0 &&
+      errno != EINTR)
+    return false;
+
+  reap();
+
+  return true;
+}
+
+void InputReader::Ring::reap()
+{
+  unsigned head = *cq_head;
+  unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+
+  for (; head != tail; ++head)
+  {
+    const io_uring_cqe &cqe = cqes[head & *cq_mask];
+    Block &block = blocks[static_cast<std::size_t>(cqe.user_data)];
+    --in_flight;
+
+    if (cqe.res < 0 && cqe.res != -EINTR && cqe.res != -EAGAIN)
+    {
+      block.failed = block.done = true;
+    }
+    else if (cqe.res == 0)
+    {
+      block.done = true;
+    }
+    else
+    {
+      block.filled += cqe.res > 0 ? static_cast<std::size_t>(cqe.res) : 0;
+      block.done = block.filled == block_size;
+
+      // A short read before the end of the file, read the rest.
+      if (!block.done && !submit(static_cast<std::size_t>(cqe.user_data)))
+        block.failed = block.done = true;
+    }
+  }
+
+  __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+}
+
+bool InputReader::start_ring(std::size_t block_size, unsigned depth)
+{
+  ring.reset(new Ring());
+
+  if (block_size == 0 || depth == 0 ||
+      !ring->setup(fd, offset, block_size, std::max(1u, depth)))
+  {
+    ring.reset();
+    return false;
+  }
+
+  return true;
+}
+
+std::size_t InputReader::read_ring(char *buffer, std::size_t size)
+{
+  std::size_t copied = 0;
+
+  while (copied < size && !ring->end)
+  {
+    std::size_t slot =
+        static_cast<std::size_t>(ring->next_block % ring->blocks.size());
+    Ring::Block &block = ring->blocks[slot];
+
+    while (!block.done)
+    {
+      if (!ring->wait())
+      {
+        error = true;
+        return copied;
+      }
+    }
+
+    if (block.failed)
+    {
+      error = ring->end = true;
+      break;
+    }
+
+    std::size_t n = std::min(size - copied, block.filled - ring->consumed);
+    std::memcpy(buffer + copied, block.data.data() + ring->consumed, n);
+    ring->consumed += n;
+    copied += n;
+
+    if (ring->consumed < block.filled)
+      continue;
+
+    // A block that isn't full ends the file.
+    if (block.filled < ring->block_size)
+    {
+      ring->end = true;
+      break;
+    }
+
+    ring->consumed = 0;
+    ++ring->next_block;
+    block.offset += ring->blocks.size() * ring->block_size;
+    block.filled = 0;
+    block.done = false;
+
+    if (!ring->submit(slot))
+      error = ring->end = true;
+  }
+
+  return copied;
+}
+#else
+struct InputReader::Ring
+{
+};
+
+bool InputReader::start_ring(std::size_t, unsigned) { return false; }
+
+std::size_t InputReader::read_ring(char *, std::size_t) { return 0; }
+#endif
+
+InputReader::InputReader(std::FILE *file)
+    : file(file), fd(-1), active(InputBackend::stdio), offset(0), error(false),
+      mapped(nullptr), mapped_size(0), map_start(0)
+{
+}
+
+InputReader::InputReader(int fd, InputBackend wanted, std::size_t block_size,
+                         unsigned depth)
+    : file(nullptr), fd(fd), active(InputBackend::read), offset(0),
+      error(false), mapped(nullptr), mapped_size(0), map_start(0)
+{
+#ifndef _WIN32
+  std::size_t size;
+
+  if (wanted == InputBackend::stdio || wanted == InputBackend::read ||
+      !regular_file(fd, size))
+    return;
+
+  // Continue from where the descriptor is, like read(2) would.
+  off_t position = lseek(fd, 0, SEEK_CUR);
+
+  if (position < 0)
+    return;
+
+  offset = static_cast<std::uint64_t>(position);
+
+  if (wanted == InputBackend::pread)
+  {
+    active = wanted;
+  }
+  else if (wanted == InputBackend::mmap)
+  {
+    // Mappings start on a page boundary.
+    std::uint64_t page = static_cast<std::uint64_t>(sysconf(_SC_PAGESIZE));
+    map_start = offset / page * page;
+    std::size_t length =
+        size > map_start ? size - static_cast<std::size_t>(map_start) : 0;
+    void *map = length > 0 ? ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd,
+                                    static_cast<off_t>(map_start))
+                           : nullptr;
+
+    if (map != MAP_FAILED)
+    {
+      if (map != nullptr)
+        madvise(map, length, MADV_SEQUENTIAL);
+
+      mapped = static_cast<const char *>(map);
+      mapped_size = length;
+      active = wanted;
+    }
+  }
+  else if (wanted == InputBackend::io_uring && start_ring(block_size, depth))
+  {
+    active = wanted;
+  }
+#else
+  (void)wanted;
+  (void)block_size;
+  (void)depth;
+#endif
+}
+
+InputReader::~InputReader()
+{
+#ifndef _WIN32
+  if (mapped != nullptr)
+    munmap(const_cast<char *>(mapped), mapped_size);
+
+  // Leave the descriptor after what was read, as reading with read(2) does.
+  if (active == InputBackend::pread || active == InputBackend::mmap ||
+      active == InputBackend::io_uring)
+    lseek(fd, static_cast<off_t>(offset), SEEK_SET);
+#endif
+}
+
+/*
+ * Read up to `size` bytes into `buffer`. Like `fread` less is only returned at
+ * the end of the input or on an error, which `failed` tells apart.
+ */
+std::size_t InputReader::read(char *buffer, std::size_t size)
+{
+  std::size_t copied = 0;
+
+  switch (active)
+  {
+  case InputBackend::stdio:
+    copied = std::fread(buffer, 1, size, file);
+    error = error || std::ferror(file) != 0;
+    break;
+
+  case InputBackend::mmap:
+  {
+    std::uint64_t at = offset - map_start;
+    copied = static_cast<std::size_t>(
+        std::min<std::uint64_t>(size, at < mapped_size ? mapped_size - at : 0));
+    std::memcpy(buffer, mapped + at, copied);
+    offset += copied;
+    break;
+  }
+
+  case InputBackend::io_uring:
+    copied = read_ring(buffer, size);
+    offset += copied;
+    break;
+
+  case InputBackend::read:
+  case InputBackend::pread:
+    while (copied < size)
+    {
+#ifdef _WIN32
+      int n = _read(fd, buffer + copied,
+                    static_cast<unsigned>(std::min<std::size_t>(
+                        size - copied, 1u << 30)));
+#else
+      ssize_t n = active == InputBackend::pread
+                      ? ::pread(fd, buffer + copied, size - copied,
+                                static_cast<off_t>(offset))
+                      : ::read(fd, buffer + copied, size - copied);
+#endif
+
+      if (n < 0 && errno == EINTR)
+        continue;
+
+      if (n <= 0)
+      {
+        error = error || n < 0;
+        break;
+      }
+
+      copied += static_cast<std::size_t>(n);
+      offset += static_cast<std::uint64_t>(n);
+    }
+    break;
+  }
+
+  return copied;
+}
+
+// vim: set ts=2 sw=2 et:
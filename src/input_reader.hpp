@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+
+enum class InputBackend
+{
+  stdio,
+  read,
+  pread,
+  mmap,
+  io_uring,
+};
+
+const char *backend_name(InputBackend backend);
+bool parse_backend(const char *name, InputBackend &backend);
+
+/*
+ * Sequential reader for the bulk validator, with a choice of how the input is
+ * read:
+ *
+ * - `stdio` reads through a `FILE`, like the validator always has.
+ * - `read` calls read(2) on the descriptor.
+ * - `pread` calls pread(2) at an offset kept by the reader.
+ * - `mmap` maps the whole file and copies from the mapping.
+ * - `io_uring` keeps `depth` reads of `block_size` bytes in flight through
+ *   io_uring, submitted with raw system calls so liburing isn't needed.
+ *
+ * `pread`, `mmap` and `io_uring` only work on regular files. If the wanted
+ * backend can't be used the reader falls back to `read`, see `backend()`. All
+ * backends start at the descriptor's current position, and the reader leaves
+ * the descriptor after what it has read.
+ */
+class InputReader
+{
+  struct Ring;
+
+  std::FILE *file;
+  int fd;
+  InputBackend active;
+  std::uint64_t offset;
+  bool error;
+  const char *mapped;
+  std::size_t mapped_size;
+  std::uint64_t map_start;
+  std::unique_ptr<Ring> ring;
+
+  InputReader(const InputReader &) = delete;
+  InputReader &operator=(const InputReader &) = delete;
+
+  bool start_ring(std::size_t block_size, unsigned depth);
+  std::size_t read_ring(char *buffer, std::size_t size);
+
+public:
+  explicit InputReader(std::FILE *file);
+  InputReader(int fd, InputBackend wanted, std::size_t block_size = 1 << 20,
+              unsigned depth = 4);
+  ~InputReader();
+
+  std::size_t read(char *buffer, std::size_t size);
+  bool failed() const { return error; }
+  InputBackend backend() const { return active; }
+};
+
+// vim: set ts=2 sw=2 et:
@@ -0,0 +1,82 @@
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+#include <fstream>
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Map the file at `path`, replacing any previously opened file. Returns false
+ * if the file can't be opened or read.
+ */
+bool MappedFile::open(const std::string &path)
+{
+  close();
+
+#ifdef _WIN32
+  std::ifstream in(path, std::ios::binary);
+
+  if (!in)
+    return false;
+
+  buffer.assign(std::istreambuf_iterator<char>(in),
+                std::istreambuf_iterator<char>());
+  contents = buffer.data();
+  length = buffer.size();
+
+  return !in.bad();
+#else
+  int fd = ::open(path.c_str(), O_RDONLY);
+
+  if (fd < 0)
+    return false;
+
+  struct stat st;
+
+  if (fstat(fd, &st) != 0)
+  {
+    ::close(fd);
+    return false;
+  }
+
+  length = static_cast<std::size_t>(st.st_size);
+
+  // Mapping an empty file fails, but an empty file is still a valid file.
+  if (length > 0)
+  {
+    void *mapped = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+
+    if (mapped == MAP_FAILED)
+    {
+      ::close(fd);
+      length = 0;
+      return false;
+    }
+
+    contents = static_cast<const unsigned char *>(mapped);
+  }
+
+  ::close(fd);
+
+  return true;
+#endif
+}
+
+void MappedFile::close()
+{
+#ifndef _WIN32
+  if (contents != nullptr)
+    munmap(const_cast<unsigned char *>(contents), length);
+#endif
+
+  buffer.clear();
+  contents = nullptr;
+  length = 0;
+}
+
+// vim: set ts=2 sw=2 et:
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/*
+ * Read only view of a whole file. The file is memory mapped on POSIX systems
+ * so opening it costs the same regardless of size; elsewhere it's read into
+ * memory.
+ */
+class MappedFile
+{
+  const unsigned char *contents;
+  std::size_t length;
+  std::vector<unsigned char> buffer;
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+public:
+  MappedFile() : contents(nullptr), length(0) {}
+  ~MappedFile() { close(); }
+
+  bool open(const std::string &path);
+  void close();
+
+  const unsigned char *data() const { return contents; }
+  std::size_t size() const { return length; }
+};
+
+// vim: set ts=2 sw=2 et:
@@ -0,0 +1,108 @@
+#include "normalize.hpp"
+
+namespace
+{
+// Results of looking at one character, the byte to write or a marker.
+const int skip = -1;
+const int reject = -2;
+
+/*
+ * Classify the character starting at `p`, of which `left` bytes remain, and
+ * set `size` to its length in bytes.
+ */
+int classify(const unsigned char *p, std::size_t left, std::size_t &size)
+{
+  unsigned char c = p[0];
+  size = 1;
+
+  if ((c >= '0' && c <= '9') || c == '-' || c == '+')
+    return c;
+
+  if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+    return skip;
+
+  if (c == 0xc2 && left >= 2 && p[1] == 0xa0)
+  {
+    // U+00A0 no-break space.
+    size = 2;
+    return skip;
+  }
+
+  if (left < 3 || (p[1] & 0xc0) != 0x80 || (p[2] & 0xc0) != 0x80)
+    return reject;
+
+  size = 3;
+  unsigned code = (c & 0x0fu) << 12 | (p[1] & 0x3fu) << 6 | (p[2] & 0x3fu);
+
+  if (c < 0xe0 || c > 0xef)
+    return reject;
+
+  // U+FF10 to U+FF19 full-width digits, U+FF0B plus and U+FF0D hyphen.
+  if (code >= 0xff10 && code <= 0xff19)
+    return '0' + static_cast<int>(code - 0xff10);
+
+  if (code == 0xff0b)
+    return '+';
+
+  // U+2010 to U+2015 dashes, U+2212 minus sign.
+  if (code == 0xff0d || (code >= 0x2010 && code <= 0x2015) || code == 0x2212)
+    return '-';
+
+  // U+2000 to U+200B spaces and zero-width space, U+202F narrow no-break
+  // space, U+205F medium mathematical space, U+3000 ideographic space and
+  // U+FEFF byte order mark.
+  if ((code >= 0x2000 && code <= 0x200b) || code == 0x202f ||
+      code == 0x205f || code == 0x3000 || code == 0xfeff)
+    return skip;
+
+  return reject;
+}
+} // namespace
+
+std::size_t normalize_personnummer(const char *in, std::size_t length,
+                                   char *out)
+{
+  const unsigned char *p = reinterpret_cast<const unsigned char *>(in);
+  const unsigned char *end = p + length;
+  std::size_t written = 0;
+
+  while (p < end)
+  {
+    // Plain ASCII digits are by far the most common, copy them right away.
+    if (*p >= '0' && *p <= '9')
+    {
+      if (written == max_formatted_length)
+        return 0;
+
+      out[written++] = static_cast<char>(*p++);
+      continue;
+    }
+
+    std::size_t size;
+    int result = classify(p, static_cast<std::size_t>(end - p), size);
+
+    if (result == reject)
+      return 0;
+
+    if (result != skip)
+    {
+      if (written == max_formatted_length)
+        return 0;
+
+      out[written++] = static_cast<char>(result);
+    }
+
+    p += size;
+  }
+
+  return written;
+}
+
+NormalizedPersonnummer::NormalizedPersonnummer(const char *data,
+                                               std::size_t length)
+    : length(normalize_personnummer(data, length, buffer)),
+      parsed(buffer, this->length)
+{
+}
+
+// vim: set ts=2 sw=2 et:
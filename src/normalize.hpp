@@ -0,0 +1,51 @@
+#pragma once
+
+#include "personnummer.hpp"
+#include "view.hpp"
+#include <cstddef>
+#include <string>
+
+/*
+ * Copy the UTF-8 input to `out`, which must have room for
+ * `max_formatted_length` bytes, in the form the parsers accept:
+ *
+ * - Full-width digits, plus and hyphen are replaced by their ASCII versions.
+ * - Unicode dashes (U+2010 to U+2015) and the minus sign are replaced by '-'.
+ * - ASCII whitespace, no-break and other Unicode spaces, zero-width spaces and
+ *   byte order marks are removed.
+ *
+ * Returns the length of the normalised input, or 0 if it contains anything
+ * else or is too long to be a number.
+ */
+std::size_t normalize_personnummer(const char *in, std::size_t length,
+                                   char *out);
+
+/*
+ * A personal identity number parsed from messy input, which is normalised into
+ * a buffer of its own. Neither normalising nor parsing allocates.
+ */
+class NormalizedPersonnummer
+{
+  char buffer[max_formatted_length];
+  std::size_t length;
+  PersonnummerView parsed;
+
+  NormalizedPersonnummer(const NormalizedPersonnummer &) = delete;
+  NormalizedPersonnummer &operator=(const NormalizedPersonnummer &) = delete;
+
+public:
+  NormalizedPersonnummer(const char *data, std::size_t length);
+  NormalizedPersonnummer(const std::string &pnr)
+      : NormalizedPersonnummer(pnr.data(), pnr.size())
+  {
+  }
+
+  const char *data() const { return buffer; }
+  std::size_t size() const { return length; }
+  const PersonnummerView &view() const { return parsed; }
+
+  bool well_formed() const { return parsed.well_formed(); }
+  bool valid() const { return parsed.valid(); }
+};
+
+// vim: set ts=2 sw=2 et:
@@ -1,4 +1,5 @@
 #include "personnummer.hpp"
+#include "stats.hpp"
 #include <cmath>
 #include <ctime>
 #include <iomanip>
@@ -62,10 +63,51 @@ bool valid_date(int year, int month, int day)
 }
 
 /*
- * Return the result of applying luhn algoritm on the passed string iterator.
+ * Return the number of days between 1970-01-01 and the given date, negative for
+ * earlier dates. Uses the constant time algorithm described at
+ * https://howardhinnant.github.io/date_algorithms.html which works on 400 year
+ * eras starting in March so leap days end up at the end of each year.
+ */
+int days_from_civil(int year, int month, int day)
+{
+  year -= month <= 2;
+
+  int era = (year >= 0 ? year : year - 399) / 400;
+  int year_of_era = year - era * 400;
+  int day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  int day_of_era =
+      year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+
+  return era * 146097 + day_of_era - 719468;
+}
+
+/*
+ * The inverse of `days_from_civil`, converting days since 1970-01-01 back to a
+ * date.
+ */
+void civil_from_days(int days, int &year, int &month, int &day)
+{
+  days += 719468;
+
+  int era = (days >= 0 ? days : days - 146096) / 146097;
+  int day_of_era = days - era * 146097;
+  int year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 -
+                     day_of_era / 146096) /
+                    365;
+  int day_of_year =
+      day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+  int month_index = (5 * day_of_year + 2) / 153;
+
+  day = day_of_year - (153 * month_index + 2) / 5 + 1;
+  month = month_index < 10 ? month_index + 3 : month_index - 9;
+  year = year_of_era + era * 400 + (month <= 2);
+}
+
+/*
+ * Return the result of applying luhn algoritm on the passed digits.
  * See more at https://en.wikipedia.org/wiki/Luhn_algorithm
  */
-int luhn(std::string::iterator begin, std::string::iterator end)
+int luhn(const char *begin, const char *end)
 {
   int sum = 0;
 
@@ -92,6 +134,24 @@ int luhn(std::string::iterator begin, std::string::iterator end)
   return checksum == 10 ? 0 : checksum;
 }
 
+int luhn(std::string::iterator begin, std::string::iterator end)
+{
+  const char *first = begin == end ? nullptr : &*begin;
+
+  return luhn(first, first + (end - begin));
+}
+
+/*
+ * Write `value` zero padded to `width` digits and advance `out` past it.
+ */
+void write_digits(char *&out, int value, int width)
+{
+  for (int i = width - 1; i >= 0; --i, value /= 10)
+    out[i] = static_cast<char>('0' + value % 10);
+
+  out += width;
+}
+
 /*
  * Create a new instance of the Personnummer class by calling `parse()` on a
  * static method. This is essentially the same as `Personnummer pnr(nr)` but is
@@ -105,6 +165,24 @@ Personnummer Personnummer::parse(const std::string &pnr)
   return pnr_instance;
 }
 
+/*
+ * Create a new instance from a key returned by `canonical_key()` without going
+ * through the string parser. The divider isn't part of the key and will be
+ * unset.
+ */
+Personnummer Personnummer::from_canonical_key(std::uint64_t key)
+{
+  Personnummer pnr_instance;
+
+  pnr_instance.date.tm_year = static_cast<int>(key / 100000000);
+  pnr_instance.date.tm_mon = static_cast<int>(key / 1000000 % 100);
+  pnr_instance.date.tm_mday = static_cast<int>(key / 10000 % 100);
+  pnr_instance.number = static_cast<int>(key / 10 % 1000);
+  pnr_instance.control = static_cast<int>(key % 10);
+
+  return pnr_instance;
+}
+
 /*
  * Receive a personal identity number string and set each part at appropreate
  * place on the date field of the Personnummer class. If the string format
@@ -115,11 +193,19 @@ void Personnummer::from_string(const std::string &pnr)
   std::regex pnr_regex("^(\\d{2})?(\\d{2})(\\d{2})(\\d{2})([-+]?)?(\\d{3})(\\d?)$");
   std::smatch matches;
 
+  date = std::tm();
+  number = 0;
+  control = 0;
+  divider = 0;
+
   if (!std::regex_search(pnr, matches, pnr_regex))
   {
+    PERSONNUMMER_COUNT(stats_parse_failed);
     return;
   }
 
+  PERSONNUMMER_COUNT(stats_parsed);
+
   int century = stoi_or_fallback(matches.str(1), 19);
   int year = stoi_or_fallback(matches.str(2), 0);
 
@@ -139,25 +225,40 @@ void Personnummer::from_string(const std::string &pnr)
  */
 std::string Personnummer::format(bool long_format) const
 {
-  std::stringstream ss;
-  ss.fill('0');
+  char buffer[max_formatted_length];
+
+  return std::string(buffer, format_to(buffer, long_format));
+}
+
+/*
+ * Same as `format()` but writes to `out` instead of allocating a string. The
+ * buffer must have room for `max_formatted_length` characters, no terminating
+ * null character is written. Returns the number of characters written.
+ */
+std::size_t Personnummer::format_to(char *out, bool long_format) const
+{
+  char *begin = out;
 
   if (long_format)
   {
-    ss << std::setw(2) << date.tm_year / 100;
+    write_digits(out, date.tm_year / 100, 2);
   }
 
-  ss << std::setw(2) << date.tm_year % 100 << std::setw(2) << date.tm_mon
-     << std::setw(2) << date.tm_mday << "-" << std::setw(3) << number
-     << control;
+  write_digits(out, date.tm_year % 100, 2);
+  write_digits(out, date.tm_mon, 2);
+  write_digits(out, date.tm_mday, 2);
+  *out++ = '-';
+  write_digits(out, number, 3);
+  write_digits(out, control, 1);
 
-  return ss.str();
+  return out - begin;
 }
 
 /*
  * Return the age of the person by calculating the diff between now and the day
  * the person was born. This is calculated in seconds, assuming each year has 6
- * extra hours due to leap year, without considering time zones.
+ * extra hours due to leap year, without considering time zones. Coordination
+ * numbers use the actual day of birth.
  */
 int Personnummer::get_age() const
 {
@@ -165,6 +266,7 @@ int Personnummer::get_age() const
   std::tm *now = std::localtime(&t);
   int current_year = now->tm_year + 1900;
   int current_mon = now->tm_mon + 1;
+  int day = date.tm_mday % coordination_extra;
 
   if (date.tm_mon > current_mon)
   {
@@ -172,7 +274,7 @@ int Personnummer::get_age() const
   }
   else
   {
-    if (date.tm_mon == current_mon && date.tm_mday > now->tm_mday)
+    if (date.tm_mon == current_mon && day > now->tm_mday)
     {
       return current_year - date.tm_year - 1;
     }
@@ -183,6 +285,17 @@ int Personnummer::get_age() const
   }
 }
 
+/*
+ * Return the birth date as days since 1970-01-01. Coordination numbers return
+ * the actual birth date. Comparing or subtracting these is the same as
+ * comparing or subtracting the dates.
+ */
+int Personnummer::birth_days() const
+{
+  return days_from_civil(date.tm_year, date.tm_mon,
+                         date.tm_mday % coordination_extra);
+}
+
 /*
  * Calculate the checksum for a given personal identity number by using the luhn
  * algoritm. Ensures that each section is zero padded to get the correct control
@@ -190,23 +303,60 @@ int Personnummer::get_age() const
  */
 int Personnummer::checksum() const
 {
-  std::stringstream ss;
-  ss.fill('0');
+  char digits[9];
+  char *out = digits;
 
-  ss << std::setw(2) << date.tm_year % 100 << std::setw(2) << date.tm_mon
-     << std::setw(2) << date.tm_mday % coordination_extra << std::setw(3)
-     << number;
+  write_digits(out, date.tm_year % 100, 2);
+  write_digits(out, date.tm_mon, 2);
+  write_digits(out, date.tm_mday % coordination_extra, 2);
+  write_digits(out, number, 3);
 
-  auto str = ss.str();
+  return luhn(digits, out);
+}
 
-  return luhn(str.begin(), str.end());
+/*
+ * Return the personal identity number as a single integer on the form
+ * YYYYMMDDNNNC. The key ignores the divider and whether the number was given in
+ * short or long format so two instances representing the same number always
+ * get the same key. Ordering by the key is the same as ordering by the long
+ * format.
+ */
+std::uint64_t Personnummer::canonical_key() const
+{
+  return static_cast<std::uint64_t>(date.tm_year) * 100000000ULL +
+         static_cast<std::uint64_t>(date.tm_mon) * 1000000ULL +
+         static_cast<std::uint64_t>(date.tm_mday) * 10000ULL +
+         static_cast<std::uint64_t>(number) * 10ULL +
+         static_cast<std::uint64_t>(control);
 }
 
 bool Personnummer::valid() const
 {
-  return valid_date(date.tm_year, date.tm_mon,
-                    date.tm_mday % coordination_extra) &&
-         number > 0 && checksum() == control;
+  PERSONNUMMER_COUNT(stats_validated);
+
+  if (is_coordination_number())
+    PERSONNUMMER_COUNT(stats_coordination);
+
+  if (!valid_date(date.tm_year, date.tm_mon,
+                  date.tm_mday % coordination_extra))
+  {
+    PERSONNUMMER_COUNT(stats_date_invalid);
+    return false;
+  }
+
+  if (number <= 0)
+  {
+    PERSONNUMMER_COUNT(stats_serial_invalid);
+    return false;
+  }
+
+  if (checksum() != control)
+  {
+    PERSONNUMMER_COUNT(stats_checksum_invalid);
+    return false;
+  }
+
+  return true;
 }
 
 // vim: set ts=2 sw=2 et:
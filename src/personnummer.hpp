@@ -1,4 +1,9 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
 #include <ctime>
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -6,8 +11,14 @@
 const int coordination_extra = 60;
 
 bool valid_date(int year, int month, int day);
+int days_from_civil(int year, int month, int day);
+void civil_from_days(int days, int &year, int &month, int &day);
+int luhn(const char *begin, const char *end);
 int luhn(std::string::iterator begin, std::string::iterator end);
 
+// The longest formatted number, long format with divider.
+const std::size_t max_formatted_length = 13;
+
 class Personnummer
 {
   std::tm date;
@@ -15,6 +26,8 @@ class Personnummer
   int control;
   char divider;
 
+  Personnummer() : date(), number(0), control(0), divider(0) {}
+
   void from_string(const std::string &pnr);
   int checksum() const;
 
@@ -22,13 +35,44 @@ public:
   Personnummer(const std::string &pnr) { from_string(pnr); }
 
   static Personnummer parse(const std::string &pnr);
+  static Personnummer from_canonical_key(std::uint64_t key);
 
   std::string format(bool long_format = false) const;
+  std::size_t format_to(char *out, bool long_format = false) const;
   int get_age() const;
+  int birth_days() const;
   bool valid() const;
   bool is_female() const { return (number % 10) % 2 == 0; }
   bool is_male() const { return !is_female(); };
   bool is_coordination_number() const { return date.tm_mday > 31; }
+
+  std::uint64_t canonical_key() const;
+
+  bool operator==(const Personnummer &other) const
+  {
+    return canonical_key() == other.canonical_key();
+  }
+  bool operator!=(const Personnummer &other) const { return !(*this == other); }
+  bool operator<(const Personnummer &other) const
+  {
+    return canonical_key() < other.canonical_key();
+  }
+};
+
+namespace std
+{
+template <> struct hash<Personnummer>
+{
+  std::size_t operator()(const Personnummer &pnr) const
+  {
+    // Finalizer from splitmix64 to spread the decimal key over all bits.
+    std::uint64_t x = pnr.canonical_key();
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+
+    return static_cast<std::size_t>(x ^ (x >> 31));
+  }
 };
+} // namespace std
 
 // vim: set ts=2 sw=2 et:
@@ -0,0 +1,90 @@
+#ifndef PERSONNUMMER_ARROW_H
+#define PERSONNUMMER_ARROW_H
+
+/*
+ * Export of parsed numbers through the Arrow C data interface, so Arrow based
+ * consumers (pyarrow, DuckDB, ...) can import them without copying or
+ * formatting them as strings. Nothing from Arrow is needed to build this, the
+ * interface is only the two structs below.
+ *
+ * Unlike the functions in `personnummer_c.h` the export allocates: the
+ * buffers belong to the exported array and are freed by its `release`
+ * callback, which the consumer calls when it is done with the data.
+ */
+
+#include "personnummer_c.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The structs as given by the Arrow C data interface specification, see
+ * https://arrow.apache.org/docs/format/CDataInterface.html */
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema
+{
+  const char *format;
+  const char *name;
+  const char *metadata;
+  int64_t flags;
+  int64_t n_children;
+  struct ArrowSchema **children;
+  struct ArrowSchema *dictionary;
+
+  void (*release)(struct ArrowSchema *);
+  void *private_data;
+};
+
+struct ArrowArray
+{
+  int64_t length;
+  int64_t null_count;
+  int64_t offset;
+  int64_t n_buffers;
+  int64_t n_children;
+  const void **buffers;
+  struct ArrowArray **children;
+  struct ArrowArray *dictionary;
+
+  void (*release)(struct ArrowArray *);
+  void *private_data;
+};
+
+#endif
+
+/* Type of a number in the `type` column. */
+enum pnr_arrow_type
+{
+  PNR_ARROW_PERSONNUMMER = 0,
+  PNR_ARROW_COORDINATION = 1
+};
+
+/* Export `count` records as a struct array with the columns
+ *
+ *   birth_date  date32  actual date of birth, also for coordination numbers
+ *   serial      uint16
+ *   control     uint8
+ *   valid       bool    `PNR_VALID`, the date, serial and control digit are
+ *                       all correct
+ *   type        uint8   `pnr_arrow_type`
+ *
+ * Records that aren't well formed are null. A well formed record with a date
+ * that doesn't exist, like February 30, has a null birth_date. Fills in `schema` and `array` and
+ * returns 0, or returns 1 without touching them if memory runs out. The
+ * schema and the array are released independently, children moved out of
+ * either stay valid after the parent is released. */
+PNR_API int pnr_export_arrow(const pnr_record *records, size_t count,
+                             struct ArrowSchema *schema,
+                             struct ArrowArray *array);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,96 @@
+#include "personnummer_c.h"
+#include "personnummer.hpp"
+#include "view.hpp"
+#include <cstring>
+
+namespace
+{
+pnr_record to_record(const PersonnummerView &view)
+{
+  pnr_record record = pnr_record();
+
+  if (!view.well_formed())
+    return record;
+
+  std::uint64_t key = view.canonical_key();
+
+  record.year = static_cast<std::uint16_t>(key / 100000000);
+  record.month = static_cast<std::uint8_t>(key / 1000000 % 100);
+  record.day = static_cast<std::uint8_t>(key / 10000 % 100);
+  record.serial = static_cast<std::uint16_t>(key / 10 % 1000);
+  record.control = static_cast<std::uint8_t>(key % 10);
+  record.flags = PNR_WELL_FORMED;
+
+  if (view.valid())
+    record.flags |= PNR_VALID;
+
+  if (view.is_coordination_number())
+    record.flags |= PNR_COORDINATION;
+
+  if (view.is_female())
+    record.flags |= PNR_FEMALE;
+
+  return record;
+}
+
+std::uint64_t to_key(const pnr_record &record)
+{
+  return static_cast<std::uint64_t>(record.year) * 100000000ULL +
+         static_cast<std::uint64_t>(record.month) * 1000000ULL +
+         static_cast<std::uint64_t>(record.day) * 10000ULL +
+         static_cast<std::uint64_t>(record.serial) * 10ULL + record.control;
+}
+} // namespace
+
+unsigned pnr_abi_version(void) { return PNR_ABI_VERSION; }
+
+size_t pnr_validate_batch(const char *const *inputs, const size_t *lengths,
+                          size_t count, uint8_t *valid)
+{
+  size_t valid_count = 0;
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    valid[i] = PersonnummerView(inputs[i], lengths[i]).valid() ? 1 : 0;
+    valid_count += valid[i];
+  }
+
+  return valid_count;
+}
+
+size_t pnr_parse_batch(const char *const *inputs, const size_t *lengths,
+                       size_t count, pnr_record *records)
+{
+  size_t valid_count = 0;
+
+  for (size_t i = 0; i < count; ++i)
+  {
+    records[i] = to_record(PersonnummerView(inputs[i], lengths[i]));
+
+    if (records[i].flags & PNR_VALID)
+      ++valid_count;
+  }
+
+  return valid_count;
+}
+
+size_t pnr_format_batch(const pnr_record *records, size_t count,
+                        int long_format, char *out)
+{
+  for (size_t i = 0; i < count; ++i, out += PNR_FORMAT_STRIDE)
+  {
+    size_t length = 0;
+
+    if (records[i].flags & PNR_WELL_FORMED)
+    {
+      length = Personnummer::from_canonical_key(to_key(records[i]))
+                   .format_to(out, long_format != 0);
+    }
+
+    out[length] = '\0';
+  }
+
+  return count;
+}
+
+// vim: set ts=2 sw=2 et:
@@ -0,0 +1,78 @@
+#ifndef PERSONNUMMER_C_H
+#define PERSONNUMMER_C_H
+
+/*
+ * C interface to the library for use over FFI. Every function works on a
+ * batch of numbers so the cost of crossing the language boundary is paid once
+ * per batch instead of once per number. No function allocates memory or keeps
+ * state between calls, all output goes to buffers owned by the caller.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#if defined(PNR_BUILDING)
+#define PNR_API __declspec(dllexport)
+#else
+#define PNR_API __declspec(dllimport)
+#endif
+#else
+#define PNR_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PNR_ABI_VERSION 1
+
+/* Bytes per number written by `pnr_format_batch`, including the terminating
+ * null character. */
+#define PNR_FORMAT_STRIDE 14
+
+enum pnr_flags
+{
+  PNR_WELL_FORMED = 1,
+  PNR_VALID = 2,
+  PNR_COORDINATION = 4,
+  PNR_FEMALE = 8
+};
+
+/* A parsed number packed in 8 bytes. `day` includes the coordination number
+ * offset of 60. */
+typedef struct pnr_record
+{
+  uint16_t year;
+  uint8_t month;
+  uint8_t day;
+  uint16_t serial;
+  uint8_t control;
+  uint8_t flags;
+} pnr_record;
+
+PNR_API unsigned pnr_abi_version(void);
+
+/* Validate `count` strings given as pointers and lengths and write 1 or 0 to
+ * `valid` for each. Returns the number of valid numbers. */
+PNR_API size_t pnr_validate_batch(const char *const *inputs,
+                                  const size_t *lengths, size_t count,
+                                  uint8_t *valid);
+
+/* Parse `count` strings into `records`. Strings that can't be parsed get a
+ * zeroed record. Returns the number of valid numbers. */
+PNR_API size_t pnr_parse_batch(const char *const *inputs,
+                               const size_t *lengths, size_t count,
+                               pnr_record *records);
+
+/* Format `count` records into `out`, `PNR_FORMAT_STRIDE` bytes per record.
+ * Records that aren't well formed are written as empty strings. Returns the
+ * number of records formatted. */
+PNR_API size_t pnr_format_batch(const pnr_record *records, size_t count,
+                                int long_format, char *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
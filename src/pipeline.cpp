@@ -0,0 +1,325 @@
+#include "pipeline.hpp"
+#include "personnummer_c.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace
+{
+typedef std::chrono::steady_clock Clock;
+
+struct Chunk
+{
+  std::vector<char> data;
+  std::size_t size;
+  // The chunk holds only the start of a line longer than a chunk.
+  bool truncated;
+
+  Chunk(std::size_t capacity) : data(capacity), size(0), truncated(false) {}
+};
+
+typedef SpscRing<Chunk *> ChunkRing;
+
+double seconds_since(Clock::time_point start)
+{
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+/*
+ * Push or pop, waiting while the ring is full or empty. A full ring is how a
+ * slow stage makes the stage before it wait. The time spent waiting is added
+ * to the stage's stall time.
+ */
+void push(ChunkRing &ring, Chunk *chunk, StageStats &stats)
+{
+  if (ring.try_push(chunk))
+    return;
+
+  Clock::time_point start = Clock::now();
+
+  while (!ring.try_push(chunk))
+    std::this_thread::yield();
+
+  stats.stalled_seconds += seconds_since(start);
+}
+
+Chunk *pop(ChunkRing &ring, StageStats &stats)
+{
+  Chunk *chunk;
+
+  if (ring.try_pop(chunk))
+    return chunk;
+
+  Clock::time_point start = Clock::now();
+
+  while (!ring.try_pop(chunk))
+    std::this_thread::yield();
+
+  stats.stalled_seconds += seconds_since(start);
+
+  return chunk;
+}
+
+struct Pipeline
+{
+  InputReader &in;
+  std::FILE *out;
+  std::vector<Chunk> input_chunks;
+  std::vector<Chunk> output_chunks;
+  ChunkRing free_input;
+  ChunkRing parse_queue;
+  ChunkRing free_output;
+  ChunkRing write_queue;
+  PipelineStats stats;
+  std::atomic<bool> read_failed;
+
+  Pipeline(InputReader &in, std::FILE *out, const PipelineOptions &options)
+      : in(in), out(out),
+        // One byte more than the longest line, for its line break.
+        input_chunks(std::max<std::size_t>(options.chunks, 3),
+                     Chunk(options.chunk_size + 1)),
+        // Room for the verdict appended to the longest possible line.
+        output_chunks(std::max<std::size_t>(options.chunks, 3),
+                      Chunk(options.chunk_size + 16)),
+        free_input(input_chunks.size()), parse_queue(input_chunks.size()),
+        free_output(output_chunks.size()), write_queue(output_chunks.size()),
+        stats(), read_failed(false)
+  {
+    for (auto &chunk : input_chunks)
+      free_input.try_push(&chunk);
+
+    for (auto &chunk : output_chunks)
+      free_output.try_push(&chunk);
+  }
+
+  void read();
+  void parse();
+  void write();
+};
+
+/*
+ * Fill chunks from the input and hand them to the parser. Each chunk ends at a
+ * line break, the partial line after it is moved to the start of the next
+ * chunk. Of a line longer than `chunk_size` only the first `chunk_size` bytes
+ * are kept, marked as truncated, and the rest of the line is skipped, so the line still
+ * gets exactly one verdict.
+ */
+void Pipeline::read()
+{
+  Clock::time_point start = Clock::now();
+  Chunk *current = pop(free_input, stats.reader);
+  current->size = 0;
+  current->truncated = false;
+  bool discarding = false;
+
+  for (;;)
+  {
+    std::size_t wanted = current->data.size() - current->size;
+    std::size_t got = in.read(current->data.data() + current->size, wanted);
+    bool end = got < wanted;
+    current->size += got;
+    stats.reader.bytes += got;
+
+    if (discarding)
+    {
+      char *data = current->data.data();
+      char *newline =
+          static_cast<char *>(std::memchr(data, '\n', current->size));
+
+      if (newline == nullptr)
+      {
+        current->size = 0;
+      }
+      else
+      {
+        std::size_t skip = newline - data + 1;
+        std::memmove(data, data + skip, current->size - skip);
+        current->size -= skip;
+        discarding = false;
+      }
+
+      if (!end)
+        continue;
+    }
+
+    if (end)
+    {
+      read_failed = in.failed();
+      break;
+    }
+
+    std::size_t cut = current->size;
+
+    while (cut > 0 && current->data[cut - 1] != '\n')
+      --cut;
+
+    // A full chunk without a line break holds a line longer than
+    // `chunk_size`, its last byte goes with the rest of the line.
+    if (cut == 0)
+    {
+      cut = current->size - 1;
+      current->truncated = discarding = true;
+    }
+
+    Chunk *next = pop(free_input, stats.reader);
+    next->truncated = false;
+    next->size = current->size - cut;
+    std::memcpy(next->data.data(), current->data.data() + cut, next->size);
+    current->size = cut;
+
+    push(parse_queue, current, stats.reader);
+    ++stats.reader.chunks;
+    current = next;
+  }
+
+  if (current->size > 0)
+  {
+    push(parse_queue, current, stats.reader);
+    ++stats.reader.chunks;
+  }
+
+  push(parse_queue, nullptr, stats.reader);
+  stats.reader.busy_seconds = seconds_since(start) - stats.reader.stalled_seconds;
+}
+
+/*
+ * Split chunks into lines and validate them in batches with
+ * `pnr_validate_batch`. Each line is written back followed by a tab and the
+ * verdict.
+ */
+void Pipeline::parse()
+{
+  const std::size_t batch_size = 256;
+  const char *lines[batch_size];
+  std::size_t lengths[batch_size];
+  std::size_t ends[batch_size];
+  std::uint8_t valid[batch_size];
+
+  Clock::time_point start = Clock::now();
+  Chunk *output = pop(free_output, stats.parser);
+  output->size = 0;
+
+  while (Chunk *input = pop(parse_queue, stats.parser))
+  {
+    const char *data = input->data.data();
+    std::size_t pos = 0;
+
+    while (pos < input->size)
+    {
+      std::size_t count = 0;
+
+      for (; count < batch_size && pos < input->size; ++count)
+      {
+        const char *line = data + pos;
+        const char *newline = static_cast<const char *>(
+            std::memchr(line, '\n', input->size - pos));
+        std::size_t length = newline ? newline - line : input->size - pos;
+
+        lines[count] = line;
+        ends[count] = length;
+        lengths[count] = length > 0 && line[length - 1] == '\r' ? length - 1
+                                                                : length;
+        pos += length + (newline ? 1 : 0);
+      }
+
+      stats.valid += pnr_validate_batch(lines, lengths, count, valid);
+      stats.records += count;
+
+      // A truncated chunk is one line without a line break.
+      if (input->truncated && valid[0])
+      {
+        valid[0] = 0;
+        --stats.valid;
+      }
+
+      for (std::size_t i = 0; i < count; ++i)
+      {
+        if (output->data.size() - output->size < ends[i] + 9)
+        {
+          stats.parser.bytes += output->size;
+          push(write_queue, output, stats.parser);
+          output = pop(free_output, stats.parser);
+          output->size = 0;
+        }
+
+        char *to = output->data.data() + output->size;
+        std::memcpy(to, lines[i], ends[i]);
+        to += ends[i];
+
+        const char *verdict = valid[i] ? "\tvalid\n" : "\tinvalid\n";
+        std::size_t verdict_length = valid[i] ? 7 : 9;
+        std::memcpy(to, verdict, verdict_length);
+
+        output->size += ends[i] + verdict_length;
+      }
+    }
+
+    ++stats.parser.chunks;
+    push(free_input, input, stats.parser);
+  }
+
+  stats.parser.bytes += output->size;
+  push(write_queue, output, stats.parser);
+  push(write_queue, nullptr, stats.parser);
+  stats.parser.busy_seconds = seconds_since(start) - stats.parser.stalled_seconds;
+}
+
+void Pipeline::write()
+{
+  Clock::time_point start = Clock::now();
+
+  while (Chunk *chunk = pop(write_queue, stats.writer))
+  {
+    if (!stats.failed &&
+        std::fwrite(chunk->data.data(), 1, chunk->size, out) != chunk->size)
+      stats.failed = true;
+
+    stats.writer.bytes += chunk->size;
+    ++stats.writer.chunks;
+    push(free_output, chunk, stats.writer);
+  }
+
+  if (std::fflush(out) != 0)
+    stats.failed = true;
+
+  stats.writer.busy_seconds = seconds_since(start) - stats.writer.stalled_seconds;
+}
+} // namespace
+
+/*
+ * Validate every line of `in` and write it to `out` followed by a tab and
+ * "valid" or "invalid". A line longer than `chunk_size` is invalid and only
+ * its first `chunk_size` bytes are written. Reading, validating and writing
+ * run on separate threads connected by single producer single consumer rings,
+ * so I/O and validation overlap. The number of chunks bounds memory use, when
+ * one stage falls behind the others wait for it.
+ */
+PipelineStats run_pipeline(InputReader &in, std::FILE *out,
+                           const PipelineOptions &options)
+{
+  Clock::time_point start = Clock::now();
+  Pipeline pipeline(in, out, options);
+
+  std::thread reader(&Pipeline::read, &pipeline);
+  std::thread parser(&Pipeline::parse, &pipeline);
+  pipeline.write();
+
+  reader.join();
+  parser.join();
+
+  pipeline.stats.failed = pipeline.stats.failed || pipeline.read_failed;
+  pipeline.stats.seconds = seconds_since(start);
+
+  return pipeline.stats;
+}
+
+PipelineStats run_pipeline(std::FILE *in, std::FILE *out,
+                           const PipelineOptions &options)
+{
+  InputReader reader(in);
+
+  return run_pipeline(reader, out, options);
+}
+
+// vim: set ts=2 sw=2 et:
@@ -0,0 +1,103 @@
+#pragma once
+
+#include "input_reader.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+/*
+ * Bounded lock free queue for exactly one producer and one consumer thread.
+ * The capacity is rounded up to a power of two.
+ */
+template <typename T> class SpscRing
+{
+  std::vector<T> slots;
+  std::size_t mask;
+
+  // Keep the indexes on separate cache lines so the producer and the consumer
+  // don't invalidate each other's caches on every operation.
+  char pad_head[64];
+  std::atomic<std::size_t> head;
+  char pad_tail[64];
+  std::atomic<std::size_t> tail;
+  char pad_end[64];
+
+  static std::size_t round_up(std::size_t n)
+  {
+    std::size_t size = 1;
+
+    while (size < n)
+      size <<= 1;
+
+    return size;
+  }
+
+public:
+  SpscRing(std::size_t capacity)
+      : slots(round_up(capacity)), mask(round_up(capacity) - 1), head(0),
+        tail(0)
+  {
+  }
+
+  bool try_push(const T &value)
+  {
+    std::size_t t = tail.load(std::memory_order_relaxed);
+
+    if (t - head.load(std::memory_order_acquire) == slots.size())
+      return false;
+
+    slots[t & mask] = value;
+    tail.store(t + 1, std::memory_order_release);
+
+    return true;
+  }
+
+  bool try_pop(T &value)
+  {
+    std::size_t h = head.load(std::memory_order_relaxed);
+
+    if (h == tail.load(std::memory_order_acquire))
+      return false;
+
+    value = slots[h & mask];
+    head.store(h + 1, std::memory_order_release);
+
+    return true;
+  }
+};
+
+struct StageStats
+{
+  std::uint64_t chunks;
+  std::uint64_t bytes;
+  double busy_seconds;
+  double stalled_seconds;
+};
+
+struct PipelineStats
+{
+  StageStats reader;
+  StageStats parser;
+  StageStats writer;
+  std::uint64_t records;
+  std::uint64_t valid;
+  double seconds;
+  bool failed;
+};
+
+struct PipelineOptions
+{
+  std::size_t chunk_size;
+  std::size_t chunks;
+
+  PipelineOptions() : chunk_size(1 << 20), chunks(8) {}
+};
+
+PipelineStats run_pipeline(std::FILE *in, std::FILE *out,
+                           const PipelineOptions &options = PipelineOptions());
+PipelineStats run_pipeline(InputReader &in, std::FILE *out,
+                           const PipelineOptions &options = PipelineOptions());
+
+// vim: set ts=2 sw=2 et:
@@ -0,0 +1,217 @@
+#include "radix_sort.hpp"
+#include <algorithm>
+#include <thread>
+
+namespace
+{
+const int digit_bits = 11;
+const std::size_t buckets = 1 << digit_bits;
+const std::uint64_t digit_mask = buckets - 1;
+
+// Below this many keys per thread starting threads costs more than it saves.
+const std::size_t min_keys_per_thread = 1 << 16;
+
+/*
+ * One counting pass over the digit at `shift`, moving keys from `from` to `to`.
+ * Each thread counts and moves its own contiguous part of the input, writing
+ * to positions given by the counts of all parts so the pass stays stable.
+ * Returns false without moving anything if every key has the same digit.
+ */
+bool radix_pass(const std::uint64_t *from, std::uint64_t *to,
+                std::size_t count, int shift, unsigned threads)
+{
+  std::vector<std::vector<std::size_t>> counts(
+      threads, std::vector<std::size_t>(buckets, 0));
+  std::size_t part = (count + threads - 1) / threads;
+
+  auto for_each_part = [&](void (*work)(const std::uint64_t *, std::size_t,
+                                        std::size_t, int, std::size_t *,
+                                        std::uint64_t *)) {
+    std::vector<std::thread> workers;
+
+    for (unsigned t = 1; t < threads; ++t)
+    {
+      workers.emplace_back(work, from, std::min(t * part, count),
+                           std::min((t + 1) * part, count), shift,
+                           counts[t].data(), to);
+    }
+
+    work(from, 0, std::min(part, count), shift, counts[0].data(), to);
+
+    for (auto &worker : workers)
+      worker.join();
+  };
+
+  for_each_part([](const std::uint64_t *keys, std::size_t begin,
+                   std::size_t end, int shift, std::size_t *count,
+                   std::uint64_t *) {
+    for (std::size_t i = begin; i < end; ++i)
+      ++count[(keys[i] >> shift) & digit_mask];
+  });
+
+  // Turn the counts into starting positions, bucket by bucket and within each
+  // bucket part by part.
+  std::size_t position = 0;
+
+  for (std::size_t bucket = 0; bucket < buckets; ++bucket)
+  {
+    std::size_t total = 0;
+
+    for (unsigned t = 0; t < threads; ++t)
+      total += counts[t][bucket];
+
+    if (total == count)
+      return false;
+
+    for (unsigned t = 0; t < threads; ++t)
+    {
+      std::size_t n = counts[t][bucket];
+      counts[t][bucket] = position;
+      position += n;
+    }
+  }
+
+  for_each_part([](const std::uint64_t *keys, std::size_t begin,
+                   std::size_t end, int shift, std::size_t *next,
+                   std::uint64_t *to) {
+    for (std::size_t i = begin; i < end; ++i)
+      to[next[(keys[i] >> shift) & digit_mask]++] = keys[i];
+  });
+
+  return true;
+}
+
+/*
+ * Stable counting sort of `keys` into `grouped` by the bucket returned by
+ * `bucket_of`. Keys for which `bucket_of` returns a negative value or a value
+ * of at least `bucket_count` are left out. Returns the start of every bucket
+ * followed by the number of grouped keys.
+ */
+template <typename F>
+std::vector<std::size_t> counting_sort(const std::uint64_t *keys,
+                                       std::size_t count, int bucket_count,
+                                       std::uint64_t *grouped, F bucket_of)
+{
+  std::vector<std::size_t> offsets(bucket_count + 1, 0);
+
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    int bucket = bucket_of(keys[i]);
+
+    if (bucket >= 0 && bucket < bucket_count)
+      ++offsets[bucket + 1];
+  }
+
+  for (int bucket = 0; bucket < bucket_count; ++bucket)
+    offsets[bucket + 1] += offsets[bucket];
+
+  std::vector<std::size_t> next(offsets.begin(), offsets.end() - 1);
+
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    int bucket = bucket_of(keys[i]);
+
+    if (bucket >= 0 && bucket < bucket_count)
+      grouped[next[bucket]++] = keys[i];
+  }
+
+  return offsets;
+}
+} // namespace
+
+/*
+ * Sort keys with a least significant digit first radix sort, 11 bits per pass.
+ * Only as many passes as needed for the largest key are made, which is four
+ * for canonical keys, and passes where all keys share the digit are skipped.
+ * With more than one thread each pass is split between the threads.
+ */
+void radix_sort(std::uint64_t *keys, std::size_t count, unsigned threads)
+{
+  if (count < 2)
+    return;
+
+  threads = std::max(1u, std::min<unsigned>(
+                             threads, static_cast<unsigned>(
+                                          count / min_keys_per_thread + 1)));
+
+  std::uint64_t max_key = *std::max_element(keys, keys + count);
+  std::vector<std::uint64_t> buffer(count);
+  std::uint64_t *from = keys;
+  std::uint64_t *to = buffer.data();
+
+  for (int shift = 0; shift < 64 && (max_key >> shift) != 0;
+       shift += digit_bits)
+  {
+    if (radix_pass(from, to, count, shift, threads))
+      std::swap(from, to);
+  }
+
+  if (from != keys)
+    std::copy(from, from + count, keys);
+}
+
+/*
+ * Sort numbers by their canonical key. The numbers are rebuilt from the sorted
+ * keys so the divider of the input isn't kept.
+ */
+void radix_sort(std::vector<Personnummer> &pnrs, unsigned threads)
+{
+  std::vector<std::uint64_t> keys(pnrs.size());
+
+  for (std::size_t i = 0; i < pnrs.size(); ++i)
+    keys[i] = pnrs[i].canonical_key();
+
+  radix_sort(keys.data(), keys.size(), threads);
+
+  for (std::size_t i = 0; i < pnrs.size(); ++i)
+    pnrs[i] = Personnummer::from_canonical_key(keys[i]);
+}
+
+/*
+ * Group keys by birth year with a counting sort, keeping the input order within
+ * each year. Returns where each year from `first_year` to `last_year` starts in
+ * `grouped`, followed by the number of grouped keys. Keys outside of the range
+ * are left out.
+ */
+std::vector<std::size_t> group_by_birth_year(const std::uint64_t *keys,
+                                             std::size_t count, int first_year,
+                                             int last_year,
+                                             std::uint64_t *grouped)
+{
+  return counting_sort(keys, count, last_year - first_year + 1, grouped,
+                       [=](std::uint64_t key) {
+                         return static_cast<int>(key / 100000000) - first_year;
+                       });
+}
+
+/*
+ * Same as `group_by_birth_year` but with one group per day, using
+ * `days_from_civil` to number the days. Coordination numbers are grouped on
+ * their actual birth date. Keys with a date that doesn't exist are left out.
+ */
+std::vector<std::size_t> group_by_birth_date(const std::uint64_t *keys,
+                                             std::size_t count, int first_year,
+                                             int last_year,
+                                             std::uint64_t *grouped)
+{
+  int first_day = days_from_civil(first_year, 1, 1);
+  int days = days_from_civil(last_year + 1, 1, 1) - first_day;
+
+  return counting_sort(
+      keys, count, days, grouped, [=](std::uint64_t key) {
+        int year = static_cast<int>(key / 100000000);
+        int month = static_cast<int>(key / 1000000 % 100);
+        int day = static_cast<int>(key / 10000 % 100);
+
+        if (day > coordination_extra)
+          day -= coordination_extra;
+
+        if (year < first_year || year > last_year ||
+            !valid_date(year, month, day))
+          return -1;
+
+        return days_from_civil(year, month, day) - first_day;
+      });
+}
+
+// vim: set ts=2 sw=2 et:
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "personnummer.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+ * Sorting and grouping of canonical keys, see `Personnummer::canonical_key`.
+ * Sorting keys is the same as sorting numbers by their long format.
+ */
+void radix_sort(std::uint64_t *keys, std::size_t count, unsigned threads = 1);
+void radix_sort(std::vector<Personnummer> &pnrs, unsigned threads = 1);
+
+std::vector<std::size_t> group_by_birth_year(const std::uint64_t *keys,
+                                             std::size_t count, int first_year,
+                                             int last_year,
+                                             std::uint64_t *grouped);
+std::vector<std::size_t> group_by_birth_date(const std::uint64_t *keys,
+                                             std::size_t count, int first_year,
+                                             int last_year,
+                                             std::uint64_t *grouped);
+
+// vim: set ts=2 sw=2 et:
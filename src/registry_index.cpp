@@ -0,0 +1,126 @@
+#include "registry_index.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+const char index_magic[8] = {'P', 'N', 'R', 'I', 'N', 'D', 'E', 'X'};
+const std::uint32_t index_version = 1;
+const std::uint32_t index_byte_order = 0x01020304;
+
+struct IndexHeader
+{
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t byte_order;
+  std::uint64_t count;
+};
+} // namespace
+
+/*
+ * Sort and deduplicate `keys` and write them as an index to `path`. Returns
+ * false if the file couldn't be written.
+ */
+bool write_index(const std::string &path, std::vector<std::uint64_t> keys)
+{
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+  IndexHeader header;
+  std::memcpy(header.magic, index_magic, sizeof(header.magic));
+  header.version = index_version;
+  header.byte_order = index_byte_order;
+  header.count = keys.size();
+
+  std::FILE *out = std::fopen(path.c_str(), "wb");
+
+  if (out == nullptr)
+    return false;
+
+  bool ok = std::fwrite(&header, sizeof(header), 1, out) == 1 &&
+            std::fwrite(keys.data(), sizeof(std::uint64_t), keys.size(),
+                        out) == keys.size();
+
+  return std::fclose(out) == 0 && ok;
+}
+
+/*
+ * Open an index written by `write_index`. Returns false if the file is missing,
+ * truncated or written by a different version or on a host with a different
+ * byte order.
+ */
+bool PersonnummerIndex::open(const std::string &path)
+{
+  keys = nullptr;
+  count = 0;
+
+  if (!file.open(path) || file.size() < sizeof(IndexHeader))
+    return false;
+
+  IndexHeader header;
+  std::memcpy(&header, file.data(), sizeof(header));
+
+  if (std::memcmp(header.magic, index_magic, sizeof(header.magic)) != 0 ||
+      header.version != index_version ||
+      header.byte_order != index_byte_order ||
+      (file.size() - sizeof(header)) / sizeof(std::uint64_t) < header.count)
+  {
+    file.close();
+    return false;
+  }
+
+  keys = reinterpret_cast<const std::uint64_t *>(file.data() + sizeof(header));
+  count = static_cast<std::size_t>(header.count);
+
+  return true;
+}
+
+/*
+ * Return the number of keys in the index that are less than `key`. Keys are
+ * roughly evenly spread within each birth year so every other step guesses the
+ * position by interpolation. The steps in between halve the range to keep the
+ * worst case logarithmic when the guesses are off.
+ */
+std::size_t PersonnummerIndex::rank(std::uint64_t key) const
+{
+  std::size_t lo = 0;
+  std::size_t hi = count;
+
+  for (bool interpolate = true; hi - lo > 16; interpolate ^= true)
+  {
+    std::uint64_t first = keys[lo];
+    std::uint64_t last = keys[hi - 1];
+
+    if (key <= first)
+      return lo;
+
+    if (key > last)
+      return hi;
+
+    std::size_t pos = lo + (hi - lo) / 2;
+
+    if (interpolate)
+    {
+      double fraction =
+          static_cast<double>(key - first) / static_cast<double>(last - first);
+      pos = lo + static_cast<std::size_t>(fraction * (hi - lo - 1));
+    }
+
+    if (keys[pos] < key)
+      lo = pos + 1;
+    else
+      hi = pos;
+  }
+
+  return std::lower_bound(keys + lo, keys + hi, key) - keys;
+}
+
+bool PersonnummerIndex::contains(std::uint64_t key) const
+{
+  std::size_t pos = rank(key);
+
+  return pos < count && keys[pos] == key;
+}
+
+// vim: set ts=2 sw=2 et:
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "mapped_file.hpp"
+#include "personnummer.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * A sorted on disk index of canonical keys, see `Personnummer::canonical_key`.
+ * The file is a small header followed by the keys as 64 bit integers in host
+ * byte order, so opening an index is a single mmap without any parsing.
+ */
+bool write_index(const std::string &path, std::vector<std::uint64_t> keys);
+
+class PersonnummerIndex
+{
+  MappedFile file;
+  const std::uint64_t *keys;
+  std::size_t count;
+
+public:
+  PersonnummerIndex() : keys(nullptr), count(0) {}
+
+  bool open(const std::string &path);
+
+  std::size_t size() const { return count; }
+  std::size_t rank(std::uint64_t key) const;
+  bool contains(std::uint64_t key) const;
+  bool contains(const Personnummer &pnr) const
+  {
+    return contains(pnr.canonical_key());
+  }
+};
+
+// vim: set ts=2 sw=2 et:
@@ -0,0 +1,186 @@
+#include "scan.hpp"
+#include "classify.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define PERSONNUMMER_SSE2
+#endif
+
+namespace
+{
+bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+#ifdef PERSONNUMMER_SSE2
+/*
+ * Return a bitmask with one bit per digit in the 16 bytes at `s`.
+ */
+unsigned digit_mask(const char *s)
+{
+  const __m128i zero = _mm_set1_epi8('0');
+  const __m128i nine = _mm_set1_epi8(9);
+
+  __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s));
+
+  // A byte is a digit if it's at most 9 after subtracting '0' as unsigned.
+  __m128i value = _mm_sub_epi8(chunk, zero);
+  __m128i digits = _mm_cmpeq_epi8(_mm_min_epu8(value, nine), value);
+
+  return static_cast<unsigned>(_mm_movemask_epi8(digits));
+}
+
+int lowest_bit(unsigned mask)
+{
+#if defined(__GNUC__)
+  return __builtin_ctz(mask);
+#else
+  int bit = 0;
+
+  for (; (mask & 1) == 0; mask >>= 1)
+    ++bit;
+
+  return bit;
+#endif
+}
+#endif
+
+/*
+ * Return the position of the first digit run at or after `pos`, or `length` if
+ * there is none. This is where the scanner spends most of its time. With SSE2
+ * it checks 16 positions at a time and only stops at runs of at least six
+ * digits, since nothing shorter can start a number.
+ */
+std::size_t next_run(const char *text, std::size_t length, std::size_t pos)
+{
+#ifdef PERSONNUMMER_SSE2
+  for (; pos + 32 <= length; pos += 16)
+  {
+    unsigned digits = digit_mask(text + pos) | digit_mask(text + pos + 16) << 16;
+    unsigned previous = pos > 0 && is_digit(text[pos - 1]) ? 1 : 0;
+    unsigned starts = digits & ~(digits << 1 | previous);
+    unsigned six_digits = digits & digits >> 1 & digits >> 2 & digits >> 3 &
+                          digits >> 4 & digits >> 5;
+    unsigned hits = starts & six_digits & 0xffff;
+
+    if (hits != 0)
+      return pos + lowest_bit(hits);
+  }
+#endif
+
+  for (; pos < length; ++pos)
+  {
+    if (is_digit(text[pos]) && (pos == 0 || !is_digit(text[pos - 1])))
+      return pos;
+  }
+
+  return length;
+}
+
+bool is_personal_number(const char *s, std::size_t length)
+{
+  IdentityType type = classify_identity(s, length).type;
+
+  return type == IdentityType::personnummer ||
+         type == IdentityType::samordningsnummer;
+}
+
+/*
+ * Return the length of the candidate number starting at the digit run at
+ * `pos`, or 0 if the run can't be a number. `run` is set to the length of the
+ * digit run.
+ */
+std::size_t candidate_length(const char *text, std::size_t length,
+                             std::size_t pos, std::size_t &run)
+{
+  run = 0;
+
+  while (pos + run < length && is_digit(text[pos + run]))
+    ++run;
+
+  if (run == 10 || run == 12)
+    return run;
+
+  if (run != 6 && run != 8)
+    return 0;
+
+  std::size_t divider = pos + run;
+
+  if (divider + 5 > length || (text[divider] != '-' && text[divider] != '+'))
+    return 0;
+
+  for (std::size_t i = divider + 1; i < divider + 5; ++i)
+  {
+    if (!is_digit(text[i]))
+      return 0;
+  }
+
+  if (divider + 5 < length && is_digit(text[divider + 5]))
+    return 0;
+
+  return run + 5;
+}
+} // namespace
+
+/*
+ * Find valid personal identity numbers in `text`, starting at `from`, and
+ * write up to `max_matches` of them to `matches`. Returns the number of
+ * matches written. To find more matches call again with `from` set to the end
+ * of the last match.
+ *
+ * Candidates are validated by `classify_identity` which accepts the same
+ * numbers as `Personnummer`, the short format defaults to the 1900s.
+ */
+std::size_t find_personnummer(const char *text, std::size_t length,
+                              std::size_t from, ScanMatch *matches,
+                              std::size_t max_matches)
+{
+  std::size_t found = 0;
+  std::size_t pos = from;
+
+  while (found < max_matches)
+  {
+    pos = next_run(text, length, pos);
+
+    if (pos >= length)
+      break;
+
+    std::size_t run;
+    std::size_t candidate = candidate_length(text, length, pos, run);
+
+    if (candidate > 0 && is_personal_number(text + pos, candidate))
+    {
+      matches[found].offset = pos;
+      matches[found].length = candidate;
+      ++found;
+      pos += candidate;
+    }
+    else
+    {
+      pos += run;
+    }
+  }
+
+  return found;
+}
+
+std::vector<ScanMatch> find_all_personnummer(const char *text,
+                                             std::size_t length)
+{
+  std::vector<ScanMatch> result;
+  ScanMatch batch[64];
+  std::size_t from = 0;
+
+  for (;;)
+  {
+    std::size_t found = find_personnummer(text, length, from, batch, 64);
+    result.insert(result.end(), batch, batch + found);
+
+    if (found < 64)
+      break;
+
+    from = batch[found - 1].offset + batch[found - 1].length;
+  }
+
+  return result;
+}
+
+// vim: set ts=2 sw=2 et:
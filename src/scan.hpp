@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/*
+ * A valid personal identity number found in a larger text. Numbers are found
+ * with ten or twelve digits, or six or eight digits followed by a divider and
+ * four digits, and must not be directly preceded or followed by another digit.
+ */
+struct ScanMatch
+{
+  std::size_t offset;
+  std::size_t length;
+};
+
+std::size_t find_personnummer(const char *text, std::size_t length,
+                              std::size_t from, ScanMatch *matches,
+                              std::size_t max_matches);
+std::vector<ScanMatch> find_all_personnummer(const char *text,
+                                             std::size_t length);
+inline std::vector<ScanMatch> find_all_personnummer(const std::string &text)
+{
+  return find_all_personnummer(text.data(), text.size());
+}
+
+// vim: set ts=2 sw=2 et:
@@ -0,0 +1,82 @@
+#include "serialize.hpp"
+#include <cstdint>
+
+/*
+ * Write the canonical key of the number to `out` which must have room for
+ * `binary_record_size` bytes.
+ */
+void encode_binary(const Personnummer &pnr, unsigned char *out)
+{
+  std::uint64_t key = pnr.canonical_key();
+
+  for (int i = binary_record_size - 1; i >= 0; --i, key >>= 8)
+    out[i] = static_cast<unsigned char>(key & 0xff);
+}
+
+Personnummer decode_binary(const unsigned char *in)
+{
+  std::uint64_t key = 0;
+
+  for (std::size_t i = 0; i < binary_record_size; ++i)
+    key = key << 8 | in[i];
+
+  return Personnummer::from_canonical_key(key);
+}
+
+std::size_t encoded_batch_size(std::size_t count)
+{
+  return binary_batch_header_size + count * binary_record_size;
+}
+
+/*
+ * Encode `count` numbers as a batch. The output buffer must be at least
+ * `encoded_batch_size(count)` bytes. Returns the number of bytes written.
+ */
+std::size_t encode_batch(const Personnummer *pnrs, std::size_t count,
+                         unsigned char *out)
+{
+  std::uint32_t records = static_cast<std::uint32_t>(count);
+
+  out[0] = binary_format_version;
+  out[1] = static_cast<unsigned char>(records >> 24);
+  out[2] = static_cast<unsigned char>(records >> 16);
+  out[3] = static_cast<unsigned char>(records >> 8);
+  out[4] = static_cast<unsigned char>(records);
+
+  unsigned char *record = out + binary_batch_header_size;
+
+  for (std::size_t i = 0; i < count; ++i, record += binary_record_size)
+    encode_binary(pnrs[i], record);
+
+  return encoded_batch_size(count);
+}
+
+/*
+ * Decode a batch written by `encode_batch` and append the numbers to `out`.
+ * Returns false without touching `out` if the version is unknown or the buffer
+ * is too short for the number of records in the header.
+ */
+bool decode_batch(const unsigned char *in, std::size_t size,
+                  std::vector<Personnummer> &out)
+{
+  if (size < binary_batch_header_size || in[0] != binary_format_version)
+    return false;
+
+  std::size_t count = static_cast<std::size_t>(in[1]) << 24 |
+                      static_cast<std::size_t>(in[2]) << 16 |
+                      static_cast<std::size_t>(in[3]) << 8 |
+                      static_cast<std::size_t>(in[4]);
+
+  if ((size - binary_batch_header_size) / binary_record_size < count)
+    return false;
+
+  const unsigned char *record = in + binary_batch_header_size;
+  out.reserve(out.size() + count);
+
+  for (std::size_t i = 0; i < count; ++i, record += binary_record_size)
+    out.push_back(decode_binary(record));
+
+  return true;
+}
+
+// vim: set ts=2 sw=2 et:
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "personnummer.hpp"
+#include <cstddef>
+#include <vector>
+
+/*
+ * Binary format for parsed personal identity numbers. Each number is stored as
+ * its canonical key (YYYYMMDDNNNC) in 5 bytes, big endian, so the encoding is
+ * the same on every platform and encoded numbers sort the same way as the
+ * numbers themselves.
+ *
+ * A batch is a version byte followed by the number of records as a 32 bit big
+ * endian integer and then the records back to back.
+ */
+const std::size_t binary_record_size = 5;
+const std::size_t binary_batch_header_size = 5;
+const unsigned char binary_format_version = 1;
+
+void encode_binary(const Personnummer &pnr, unsigned char *out);
+Personnummer decode_binary(const unsigned char *in);
+
+std::size_t encoded_batch_size(std::size_t count);
+std::size_t encode_batch(const Personnummer *pnrs, std::size_t count,
+                         unsigned char *out);
+bool decode_batch(const unsigned char *in, std::size_t size,
+                  std::vector<Personnummer> &out);
+
+// vim: set ts=2 sw=2 et:
@@ -0,0 +1,109 @@
+#include "stats.hpp"
+
+#ifdef PERSONNUMMER_STATS
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+namespace
+{
+const std::size_t cache_line_size = 64;
+
+struct StatsSlot
+{
+  std::atomic<std::uint64_t> counters[stats_counter_count];
+  std::atomic<bool> in_use;
+  StatsSlot *next;
+};
+
+std::atomic<StatsSlot *> slots(nullptr);
+
+/*
+ * Find a slot for the calling thread, either one left behind by a thread that
+ * has exited or a new one. Slots are never freed so the list can be walked
+ * without locks. Each slot gets its own cache line since operator new in C++11
+ * doesn't honour over aligned types.
+ */
+StatsSlot *acquire_slot()
+{
+  for (StatsSlot *slot = slots.load(std::memory_order_acquire); slot;
+       slot = slot->next)
+  {
+    bool expected = false;
+
+    if (slot->in_use.compare_exchange_strong(expected, true))
+      return slot;
+  }
+
+  char *raw = new char[sizeof(StatsSlot) + cache_line_size];
+  std::size_t misalignment =
+      reinterpret_cast<std::uintptr_t>(raw) % cache_line_size;
+  StatsSlot *slot = new (raw + cache_line_size - misalignment) StatsSlot();
+
+  slot->in_use.store(true);
+  slot->next = slots.load(std::memory_order_relaxed);
+
+  while (!slots.compare_exchange_weak(slot->next, slot,
+                                      std::memory_order_release,
+                                      std::memory_order_relaxed))
+  {
+  }
+
+  return slot;
+}
+
+/*
+ * Hands the slot back when the thread exits. The counts stay in the slot and
+ * the next thread to take it keeps adding to them.
+ */
+struct ThreadSlot
+{
+  StatsSlot *slot;
+
+  ThreadSlot() : slot(acquire_slot()) {}
+  ~ThreadSlot() { slot->in_use.store(false); }
+};
+} // namespace
+
+void stats_increment(StatsCounter counter)
+{
+  static thread_local ThreadSlot local;
+  std::atomic<std::uint64_t> &value = local.slot->counters[counter];
+
+  // Only the owning thread writes to the slot so there's no need for an atomic
+  // read-modify-write.
+  value.store(value.load(std::memory_order_relaxed) + 1,
+              std::memory_order_relaxed);
+}
+
+bool stats_enabled() { return true; }
+
+PersonnummerStats stats_snapshot()
+{
+  std::uint64_t totals[stats_counter_count] = {};
+
+  for (StatsSlot *slot = slots.load(std::memory_order_acquire); slot;
+       slot = slot->next)
+  {
+    for (int i = 0; i < stats_counter_count; ++i)
+      totals[i] += slot->counters[i].load(std::memory_order_relaxed);
+  }
+
+  PersonnummerStats stats;
+  stats.parsed = totals[stats_parsed];
+  stats.parse_failed = totals[stats_parse_failed];
+  stats.validated = totals[stats_validated];
+  stats.date_invalid = totals[stats_date_invalid];
+  stats.serial_invalid = totals[stats_serial_invalid];
+  stats.checksum_invalid = totals[stats_checksum_invalid];
+  stats.coordination = totals[stats_coordination];
+
+  return stats;
+}
+#else
+bool stats_enabled() { return false; }
+
+PersonnummerStats stats_snapshot() { return PersonnummerStats(); }
+#endif
+
+// vim: set ts=2 sw=2 et:
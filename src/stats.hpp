@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+
+/*
+ * Counters for parse and validation outcomes. Counting is compiled in when the
+ * library is built with `WITH_STATS` and compiles to nothing otherwise, in
+ * which case the snapshot is always empty.
+ *
+ * Each thread counts in its own cache line so counting never contends, and a
+ * snapshot sums the counters of all threads without locking. Counts from
+ * threads that have exited are kept.
+ */
+enum StatsCounter
+{
+  stats_parsed,
+  stats_parse_failed,
+  stats_validated,
+  stats_date_invalid,
+  stats_serial_invalid,
+  stats_checksum_invalid,
+  stats_coordination,
+  stats_counter_count
+};
+
+struct PersonnummerStats
+{
+  std::uint64_t parsed;
+  std::uint64_t parse_failed;
+  std::uint64_t validated;
+  std::uint64_t date_invalid;
+  std::uint64_t serial_invalid;
+  std::uint64_t checksum_invalid;
+  std::uint64_t coordination;
+};
+
+bool stats_enabled();
+PersonnummerStats stats_snapshot();
+
+#ifdef PERSONNUMMER_STATS
+void stats_increment(StatsCounter counter);
+#define PERSONNUMMER_COUNT(counter) stats_increment(counter)
+#else
+#define PERSONNUMMER_COUNT(counter) ((void)0)
+#endif
+
+// vim: set ts=2 sw=2 et:
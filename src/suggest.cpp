@@ -0,0 +1,156 @@
+#include "suggest.hpp"
+#include "personnummer.hpp"
+#include "view.hpp"
+#include <algorithm>
+
+namespace
+{
+// Luhn doubles every other digit and adds the digits of the product.
+const int doubled[10] = {0, 2, 4, 6, 8, 1, 3, 5, 7, 9};
+const int halved[10] = {0, 5, 1, 6, 2, 7, 3, 8, 4, 9};
+
+// The checksum of a coordination number uses the actual day of birth, which
+// is the same as ignoring this much of the first digit of the day.
+const int coordination_tens = coordination_extra / 10;
+const int day_position = 4;
+const int control_position = 9;
+
+/*
+ * Return what the digit at `position` of the ten digit body adds to the Luhn
+ * sum, which is zero modulo 10 for a valid number.
+ */
+int weight(int position, int digit)
+{
+  if (position == day_position)
+    digit %= coordination_tens;
+
+  return position % 2 == 0 && position < control_position ? doubled[digit]
+                                                          : digit;
+}
+
+std::uint64_t to_key(std::uint64_t century, const int *digits)
+{
+  std::uint64_t key = century;
+
+  for (int i = 0; i <= control_position; ++i)
+    key = key * 10 + digits[i];
+
+  return key;
+}
+
+/*
+ * Check everything but the control digit, which is already known to match.
+ */
+bool plausible(std::uint64_t century, const int *digits)
+{
+  int year = static_cast<int>(century) * 100 + digits[0] * 10 + digits[1];
+  int month = digits[2] * 10 + digits[3];
+  int day = digits[4] * 10 + digits[5];
+  int number = digits[6] * 100 + digits[7] * 10 + digits[8];
+
+  return number > 0 && valid_date(year, month, day % coordination_extra);
+}
+
+/*
+ * Instead of checking every variant of the input, the Luhn sum is computed
+ * once and each position is solved for the digits that make the sum zero.
+ * That leaves at most two candidates for a position and only the dates and
+ * serial numbers of those are checked.
+ */
+template <typename Accept>
+std::size_t suggest(const char *data, std::size_t length, std::uint64_t *keys,
+                    Accept accept)
+{
+  PersonnummerView view(data, length);
+  std::size_t digit_count = 0;
+
+  for (std::size_t i = 0; i < length; ++i)
+    digit_count += data[i] >= '0' && data[i] <= '9';
+
+  if (!view.well_formed() || (digit_count != 10 && digit_count != 12))
+    return 0;
+
+  std::uint64_t key = view.canonical_key();
+  std::uint64_t century = key / 10000000000ULL;
+  int digits[control_position + 1];
+  int sum = 0;
+
+  for (int i = control_position; i >= 0; --i, key /= 10)
+    digits[i] = static_cast<int>(key % 10);
+
+  for (int i = 0; i <= control_position; ++i)
+    sum += weight(i, digits[i]);
+
+  sum %= 10;
+
+  std::size_t count = 0;
+
+  for (int i = 0; i <= control_position; ++i)
+  {
+    int target = (weight(i, digits[i]) + 10 - sum) % 10;
+    int first = i % 2 == 0 && i < control_position ? halved[target] : target;
+    int step = i == day_position ? coordination_tens : 10;
+    int original = digits[i];
+
+    if (i == day_position && first >= coordination_tens)
+      continue;
+
+    for (int digit = first; digit <= 9; digit += step)
+    {
+      digits[i] = digit;
+
+      if (digit != original && plausible(century, digits) &&
+          accept(to_key(century, digits)))
+        keys[count++] = to_key(century, digits);
+    }
+
+    digits[i] = original;
+  }
+
+  for (int i = 0; i < control_position; ++i)
+  {
+    int a = digits[i];
+    int b = digits[i + 1];
+    int change = weight(i, b) + weight(i + 1, a) - weight(i, a) -
+                 weight(i + 1, b);
+
+    if (a == b || (sum + change + 20) % 10 != 0)
+      continue;
+
+    std::swap(digits[i], digits[i + 1]);
+
+    if (plausible(century, digits) && accept(to_key(century, digits)))
+      keys[count++] = to_key(century, digits);
+
+    std::swap(digits[i], digits[i + 1]);
+  }
+
+  std::sort(keys, keys + count);
+
+  return count;
+}
+} // namespace
+
+std::size_t suggest_corrections(const char *data, std::size_t length,
+                                std::uint64_t *keys)
+{
+  return suggest(data, length, keys, [](std::uint64_t) { return true; });
+}
+
+std::size_t suggest_corrections(const char *data, std::size_t length,
+                                std::uint64_t *keys,
+                                const PersonnummerIndex &registry)
+{
+  return suggest(data, length, keys,
+                 [&](std::uint64_t key) { return registry.contains(key); });
+}
+
+std::size_t suggest_corrections(const char *data, std::size_t length,
+                                std::uint64_t *keys,
+                                const EliasFanoSet &registry)
+{
+  return suggest(data, length, keys,
+                 [&](std::uint64_t key) { return registry.contains(key); });
+}
+
+// vim: set ts=2 sw=2 et:
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "elias_fano.hpp"
+#include "registry_index.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+ * Most suggestions a single input can get. Only one digit in each position
+ * gives the right checksum, except for the first digit of the day where two
+ * can, and there are nine pairs of neighbours to swap.
+ */
+const std::size_t max_suggestions = 20;
+
+/*
+ * Find the valid numbers that differ from the input by one mistyped digit or
+ * by two swapped neighbouring digits, and write their canonical keys in
+ * ascending order to `keys`, which must have room for `max_suggestions` keys.
+ * The century is taken as written, or 19 if there is none, and never changed.
+ * Returns the number of suggestions, which is 0 for input that isn't well
+ * formed or has no control digit.
+ *
+ * The overloads taking a registry only suggest numbers in it.
+ */
+std::size_t suggest_corrections(const char *data, std::size_t length,
+                                std::uint64_t *keys);
+std::size_t suggest_corrections(const char *data, std::size_t length,
+                                std::uint64_t *keys,
+                                const PersonnummerIndex &registry);
+std::size_t suggest_corrections(const char *data, std::size_t length,
+                                std::uint64_t *keys,
+                                const EliasFanoSet &registry);
+
+inline std::size_t suggest_corrections(const std::string &input,
+                                       std::uint64_t *keys)
+{
+  return suggest_corrections(input.data(), input.size(), keys);
+}
+
+// vim: set ts=2 sw=2 et:
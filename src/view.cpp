@@ -0,0 +1,109 @@
+#include "view.hpp"
+#include "stats.hpp"
+
+namespace
+{
+bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+int two_digits(const char *s) { return (s[0] - '0') * 10 + (s[1] - '0'); }
+} // namespace
+
+PersonnummerView::PersonnummerView(const char *data, std::size_t length)
+    : data(data), length(length), structure_ok(false), has_century(false),
+      has_divider(false), has_control(false), decoded(false),
+      pnr(Personnummer::from_canonical_key(0))
+{
+  scan();
+
+  if (structure_ok)
+    PERSONNUMMER_COUNT(stats_parsed);
+  else
+    PERSONNUMMER_COUNT(stats_parse_failed);
+}
+
+/*
+ * Check the structure of the string without decoding anything. This accepts
+ * exactly what the regular expression in `Personnummer::from_string` does: an
+ * optional century, six date digits, an optional divider, three serial digits
+ * and an optional control digit.
+ */
+void PersonnummerView::scan()
+{
+  std::size_t leading = 0;
+
+  while (leading < length && is_digit(data[leading]))
+    ++leading;
+
+  if (leading == length)
+  {
+    // Without a divider the century is present if there are more than ten
+    // digits and the control digit if the number of digits is even.
+    if (length < 9 || length > 12)
+      return;
+
+    has_century = length > 10;
+    has_control = length % 2 == 0;
+  }
+  else
+  {
+    if (leading != 6 && leading != 8)
+      return;
+
+    if (data[leading] != '-' && data[leading] != '+')
+      return;
+
+    std::size_t trailing = length - leading - 1;
+
+    if (trailing != 3 && trailing != 4)
+      return;
+
+    for (std::size_t i = leading + 1; i < length; ++i)
+    {
+      if (!is_digit(data[i]))
+        return;
+    }
+
+    has_century = leading == 8;
+    has_divider = true;
+    has_control = trailing == 4;
+  }
+
+  structure_ok = true;
+}
+
+/*
+ * Decode the fields the first time they're needed. A view that isn't well
+ * formed decodes to the same empty number as a `Personnummer` created from an
+ * invalid string.
+ */
+const Personnummer &PersonnummerView::fields() const
+{
+  if (decoded || !structure_ok)
+    return pnr;
+
+  const char *s = data;
+  std::uint64_t century = 19;
+
+  if (has_century)
+  {
+    century = two_digits(s);
+    s += 2;
+  }
+
+  std::uint64_t year = century * 100 + two_digits(s);
+  std::uint64_t month = two_digits(s + 2);
+  std::uint64_t day = two_digits(s + 4);
+  s += has_divider ? 7 : 6;
+
+  std::uint64_t number = two_digits(s) * 10 + (s[2] - '0');
+  std::uint64_t control = has_control ? s[3] - '0' : 0;
+
+  pnr = Personnummer::from_canonical_key(
+      year * 100000000ULL + month * 1000000ULL + day * 10000ULL + number * 10 +
+      control);
+  decoded = true;
+
+  return pnr;
+}
+
+// vim: set ts=2 sw=2 et:
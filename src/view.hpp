@@ -0,0 +1,55 @@
+#pragma once
+
+#include "personnummer.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+ * A personal identity number that refers to a string owned by someone else.
+ * Creating a view only checks that the string has the same structure as the
+ * one accepted by `Personnummer`, the fields are decoded the first time they're
+ * needed. The string must outlive the view.
+ *
+ * Decoding updates the view so a view shared between threads must not be read
+ * concurrently before its first decode.
+ */
+class PersonnummerView
+{
+  const char *data;
+  std::size_t length;
+  bool structure_ok;
+  bool has_century;
+  bool has_divider;
+  bool has_control;
+  mutable bool decoded;
+  mutable Personnummer pnr;
+
+  void scan();
+  const Personnummer &fields() const;
+
+public:
+  PersonnummerView(const char *data, std::size_t length);
+  PersonnummerView(const std::string &pnr)
+      : PersonnummerView(pnr.data(), pnr.size())
+  {
+  }
+
+  bool well_formed() const { return structure_ok; }
+
+  std::uint64_t canonical_key() const { return fields().canonical_key(); }
+  std::string format(bool long_format = false) const
+  {
+    return fields().format(long_format);
+  }
+  int get_age() const { return fields().get_age(); }
+  bool valid() const { return structure_ok && fields().valid(); }
+  bool is_female() const { return fields().is_female(); }
+  bool is_male() const { return fields().is_male(); }
+  bool is_coordination_number() const
+  {
+    return fields().is_coordination_number();
+  }
+};
+
+// vim: set ts=2 sw=2 et:
@@ -0,0 +1,325 @@
+#include "xor_filter.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+const char filter_magic[8] = {'P', 'N', 'R', 'X', 'O', 'R', '0', '8'};
+const std::uint32_t filter_version = 1;
+const std::uint32_t filter_byte_order = 0x01020304;
+
+// Number of seeds to try before giving up on building a filter.
+const int max_attempts = 100;
+
+// Keys looked up together in a batch, their bytes are prefetched first.
+const std::size_t batch_size = 32;
+
+struct FilterHeader
+{
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t byte_order;
+  std::uint64_t seed;
+  std::uint64_t block_length;
+  std::uint64_t count;
+};
+
+std::uint64_t mix(std::uint64_t key, std::uint64_t seed)
+{
+  // Finalizer from splitmix64, like std::hash<Personnummer>.
+  std::uint64_t x = key + seed;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+
+  return x ^ (x >> 31);
+}
+
+std::uint64_t next_seed(std::uint64_t &state)
+{
+  state += 0x9e3779b97f4a7c15ULL;
+
+  return mix(state, 0);
+}
+
+std::uint8_t fingerprint(std::uint64_t hash)
+{
+  return static_cast<std::uint8_t>(hash ^ (hash >> 32));
+}
+
+std::uint64_t rotate(std::uint64_t x, int bits)
+{
+  return bits == 0 ? x : (x << bits) | (x >> (64 - bits));
+}
+
+/*
+ * Map a hash to one slot in each of the three blocks of the filter.
+ */
+void slots(std::uint64_t hash, std::size_t block_length, std::size_t out[3])
+{
+  for (int i = 0; i < 3; ++i)
+  {
+    std::uint32_t part = static_cast<std::uint32_t>(rotate(hash, 21 * i));
+
+    out[i] = static_cast<std::size_t>(
+                 (static_cast<std::uint64_t>(part) * block_length) >> 32) +
+             i * block_length;
+  }
+}
+
+struct Slot
+{
+  std::uint64_t hashes;
+  std::uint32_t count;
+};
+
+struct Peeled
+{
+  std::uint64_t hash;
+  std::size_t slot;
+};
+
+/*
+ * Try to find an order to assign fingerprints in. Every key is peeled off from
+ * a slot that no other remaining key uses. Fails if some keys can't be peeled,
+ * which happens rarely and is fixed by trying another seed.
+ */
+bool peel(const std::vector<std::uint64_t> &keys, std::uint64_t seed,
+          std::size_t block_length, std::vector<Peeled> &order)
+{
+  std::vector<Slot> table(3 * block_length, Slot{0, 0});
+  std::vector<std::size_t> queue;
+  std::size_t position[3];
+
+  for (std::uint64_t key : keys)
+  {
+    std::uint64_t hash = mix(key, seed);
+    slots(hash, block_length, position);
+
+    for (std::size_t slot : position)
+    {
+      table[slot].hashes ^= hash;
+      ++table[slot].count;
+    }
+  }
+
+  for (std::size_t slot = 0; slot < table.size(); ++slot)
+  {
+    if (table[slot].count == 1)
+      queue.push_back(slot);
+  }
+
+  order.clear();
+
+  while (!queue.empty())
+  {
+    std::size_t slot = queue.back();
+    queue.pop_back();
+
+    if (table[slot].count != 1)
+      continue;
+
+    std::uint64_t hash = table[slot].hashes;
+    order.push_back(Peeled{hash, slot});
+    slots(hash, block_length, position);
+
+    for (std::size_t other : position)
+    {
+      table[other].hashes ^= hash;
+
+      if (--table[other].count == 1)
+        queue.push_back(other);
+    }
+  }
+
+  return order.size() == keys.size();
+}
+} // namespace
+
+void XorFilter::reset()
+{
+  storage.clear();
+  file.close();
+  fingerprints = nullptr;
+  seed = 0;
+  block_length = 0;
+  count = 0;
+}
+
+/*
+ * Build a filter for the keys, replacing the current content. The keys don't
+ * have to be sorted or unique. Returns false, leaving the filter empty, in the
+ * very unlikely case that no working seed is found.
+ */
+bool XorFilter::build(const std::vector<std::uint64_t> &keys)
+{
+  reset();
+
+  std::vector<std::uint64_t> unique(keys);
+  std::sort(unique.begin(), unique.end());
+  unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+
+  if (unique.empty())
+    return true;
+
+  std::size_t capacity = 32 + unique.size() * 123 / 100;
+  std::size_t length = (capacity + 2) / 3;
+  std::vector<Peeled> order;
+  std::uint64_t state = 0;
+
+  for (int attempt = 0; attempt < max_attempts; ++attempt)
+  {
+    std::uint64_t candidate = next_seed(state);
+
+    if (!peel(unique, candidate, length, order))
+      continue;
+
+    // Assign in reverse, so each key's slot is set after its other two.
+    storage.assign(3 * length, 0);
+    std::size_t position[3];
+
+    for (std::size_t i = order.size(); i-- > 0;)
+    {
+      slots(order[i].hash, length, position);
+      std::uint8_t value = fingerprint(order[i].hash);
+
+      for (std::size_t slot : position)
+      {
+        if (slot != order[i].slot)
+          value ^= storage[slot];
+      }
+
+      storage[order[i].slot] = value;
+    }
+
+    fingerprints = storage.data();
+    seed = candidate;
+    block_length = length;
+    count = unique.size();
+
+    return true;
+  }
+
+  return false;
+}
+
+bool XorFilter::write(const std::string &path) const
+{
+  FilterHeader header;
+  std::memcpy(header.magic, filter_magic, sizeof(header.magic));
+  header.version = filter_version;
+  header.byte_order = filter_byte_order;
+  header.seed = seed;
+  header.block_length = block_length;
+  header.count = count;
+
+  std::FILE *out = std::fopen(path.c_str(), "wb");
+
+  if (out == nullptr)
+    return false;
+
+  bool ok = std::fwrite(&header, sizeof(header), 1, out) == 1 &&
+            std::fwrite(fingerprints, 1, 3 * block_length, out) ==
+                3 * block_length;
+
+  return std::fclose(out) == 0 && ok;
+}
+
+/*
+ * Open a filter written by `write`. The file is memory mapped and used as is.
+ * Returns false, leaving the filter empty, if the file is missing, truncated
+ * or written by a different version or on a host with a different byte order.
+ */
+bool XorFilter::open(const std::string &path)
+{
+  reset();
+
+  if (!file.open(path) || file.size() < sizeof(FilterHeader))
+  {
+    reset();
+    return false;
+  }
+
+  FilterHeader header;
+  std::memcpy(&header, file.data(), sizeof(header));
+
+  if (std::memcmp(header.magic, filter_magic, sizeof(header.magic)) != 0 ||
+      header.version != filter_version ||
+      header.byte_order != filter_byte_order ||
+      header.block_length > (file.size() - sizeof(header)) / 3)
+  {
+    reset();
+    return false;
+  }
+
+  fingerprints = file.data() + sizeof(header);
+  seed = header.seed;
+  block_length = static_cast<std::size_t>(header.block_length);
+  count = static_cast<std::size_t>(header.count);
+
+  return true;
+}
+
+bool XorFilter::contains(std::uint64_t key) const
+{
+  if (block_length == 0)
+    return false;
+
+  std::uint64_t hash = mix(key, seed);
+  std::size_t position[3];
+  slots(hash, block_length, position);
+
+  return fingerprint(hash) == (fingerprints[position[0]] ^
+                               fingerprints[position[1]] ^
+                               fingerprints[position[2]]);
+}
+
+/*
+ * Look up `n` keys, setting `result[i]` for each key that may be in the set,
+ * and return the number of such keys. Keys are handled in small batches where
+ * all slots are prefetched before any is read, so the cache misses of a batch
+ * overlap instead of being waited for one at a time.
+ */
+std::size_t XorFilter::contains(const std::uint64_t *keys, std::size_t n,
+                                bool *result) const
+{
+  if (block_length == 0)
+  {
+    std::fill(result, result + n, false);
+    return 0;
+  }
+
+  std::uint64_t hashes[batch_size];
+  std::size_t position[batch_size][3];
+  std::size_t found = 0;
+
+  for (std::size_t start = 0; start < n; start += batch_size)
+  {
+    std::size_t end = std::min(n, start + batch_size);
+
+    for (std::size_t i = start; i < end; ++i)
+    {
+      hashes[i - start] = mix(keys[i], seed);
+      slots(hashes[i - start], block_length, position[i - start]);
+
+#if defined(__GNUC__)
+      for (std::size_t slot : position[i - start])
+        __builtin_prefetch(fingerprints + slot);
+#endif
+    }
+
+    for (std::size_t i = start; i < end; ++i)
+    {
+      const std::size_t *slot = position[i - start];
+
+      result[i] = fingerprint(hashes[i - start]) ==
+                  (fingerprints[slot[0]] ^ fingerprints[slot[1]] ^
+                   fingerprints[slot[2]]);
+      found += result[i];
+    }
+  }
+
+  return found;
+}
+
+// vim: set ts=2 sw=2 et:
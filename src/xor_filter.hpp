@@ -0,0 +1,53 @@
+#pragma once
+
+#include "mapped_file.hpp"
+#include "personnummer.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Approximate set of canonical keys using an 8 bit xor filter. Every key in the
+ * set is reported as contained; a key that isn't is reported as contained with
+ * a probability of about 1/256. The filter takes about 1.23 bytes per key and
+ * a lookup reads three bytes, which makes it a cheap check to run before an
+ * exact lookup in a larger set.
+ *
+ * A filter can be built in memory, written to a file and opened again with
+ * mmap.
+ */
+class XorFilter
+{
+  std::vector<std::uint8_t> storage;
+  MappedFile file;
+  const std::uint8_t *fingerprints;
+  std::uint64_t seed;
+  std::size_t block_length;
+  std::size_t count;
+
+  XorFilter(const XorFilter &) = delete;
+  XorFilter &operator=(const XorFilter &) = delete;
+
+  void reset();
+
+public:
+  XorFilter() { reset(); }
+
+  bool build(const std::vector<std::uint64_t> &keys);
+  bool write(const std::string &path) const;
+  bool open(const std::string &path);
+
+  std::size_t size() const { return count; }
+  std::size_t memory_usage() const { return 3 * block_length; }
+
+  bool contains(std::uint64_t key) const;
+  bool contains(const Personnummer &pnr) const
+  {
+    return contains(pnr.canonical_key());
+  }
+  std::size_t contains(const std::uint64_t *keys, std::size_t n,
+                       bool *result) const;
+};
+
+// vim: set ts=2 sw=2 et:
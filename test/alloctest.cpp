@@ -0,0 +1,119 @@
+#include "dedupe.hpp"
+#include "format_arena.hpp"
+#include "normalize.hpp"
+#include "personnummer.hpp"
+#include "serialize.hpp"
+#include "view.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+/*
+ * Counts every heap allocation made through operator new. This is a separate
+ * executable since replacing the global allocator affects the whole program.
+ */
+static unsigned long allocations = 0;
+
+void *operator new(std::size_t size)
+{
+  ++allocations;
+
+  if (void *p = std::malloc(size ? size : 1))
+    return p;
+
+  throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete[](void *p) noexcept { std::free(p); }
+
+const int iterations = 1000;
+int failures = 0;
+
+/*
+ * Run `fn` a number of times after a warm up call (which may initialise time
+ * zones or thread local state) and return the number of allocations per call.
+ */
+template <typename F> double allocations_per_call(F fn)
+{
+  fn();
+
+  unsigned long before = allocations;
+
+  for (int i = 0; i < iterations; ++i)
+    fn();
+
+  return static_cast<double>(allocations - before) / iterations;
+}
+
+template <typename F> void require_no_allocations(const char *name, F fn)
+{
+  double per_call = allocations_per_call(fn);
+
+  std::printf("%-40s %6.2f allocations/op%s\n", name, per_call,
+              per_call > 0 ? "  FAILED" : "");
+
+  if (per_call > 0)
+    ++failures;
+}
+
+template <typename F> void report_allocations(const char *name, F fn)
+{
+  std::printf("%-40s %6.2f allocations/op\n", name, allocations_per_call(fn));
+}
+
+int main()
+{
+  const std::string input = "19900101-0017";
+  const Personnummer pnr(input);
+  PersonnummerSet set(1990, 1990);
+  volatile bool sink = false;
+  char buffer[max_formatted_length];
+  unsigned char record[binary_record_size];
+
+  require_no_allocations("PersonnummerView", [&]() {
+    PersonnummerView view(input.data(), input.size());
+    sink = view.valid() && view.is_male() && view.get_age() > 0;
+  });
+  require_no_allocations("NormalizedPersonnummer", [&]() {
+    const char messy[] = " 19900101\xe2\x80\x93\xef\xbc\x90"
+                         "017\xc2\xa0";
+    NormalizedPersonnummer normalized(messy, sizeof(messy) - 1);
+    sink = normalized.valid();
+  });
+  require_no_allocations("Personnummer::valid",
+                         [&]() { sink = pnr.valid(); });
+  require_no_allocations("Personnummer::get_age",
+                         [&]() { sink = pnr.get_age() > 0; });
+  require_no_allocations("Personnummer::from_canonical_key", [&]() {
+    sink = Personnummer::from_canonical_key(pnr.canonical_key()).valid();
+  });
+  require_no_allocations("Personnummer::format_to", [&]() {
+    sink = pnr.format_to(buffer, true) == max_formatted_length;
+  });
+  require_no_allocations("encode_binary/decode_binary", [&]() {
+    encode_binary(pnr, record);
+    sink = decode_binary(record) == pnr;
+  });
+  require_no_allocations("PersonnummerSet::insert",
+                         [&]() { sink = set.insert(pnr); });
+
+  FormatArena arena;
+  std::vector<Personnummer> batch(100, pnr);
+  require_no_allocations("FormatArena::append after clear", [&]() {
+    arena.clear();
+    sink = arena.append(batch.data(), batch.size(), true) == 0;
+  });
+
+  report_allocations("Personnummer(std::string) (legacy)",
+                     [&]() { sink = Personnummer(input).valid(); });
+  report_allocations("Personnummer::format (legacy)",
+                     [&]() { sink = pnr.format(true).size() > 0; });
+
+  return failures == 0 ? 0 : 1;
+}
+
+// vim: set ts=2 sw=2 et:
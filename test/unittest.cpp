@@ -2,8 +2,39 @@
 
 #define CATCH_CONFIG_MAIN
 #include "catch.hpp"
+#include "age.hpp"
+#include "classify.hpp"
+#include "control_digit.hpp"
+#include "dedupe.hpp"
+#include "elias_fano.hpp"
+#include "format_arena.hpp"
+#include "normalize.hpp"
 #include "personnummer.hpp"
+#include "personnummer_arrow.h"
+#include "personnummer_c.h"
+#include "pipeline.hpp"
+#include "radix_sort.hpp"
+#include "registry_index.hpp"
+#include "scan.hpp"
+#include "serialize.hpp"
+#include "stats.hpp"
+#include "suggest.hpp"
+#include "view.hpp"
+#include "xor_filter.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
 #include <ctime>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <thread>
+#include <unordered_set>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 
 struct TestDate
 {
@@ -239,4 +270,1232 @@ TEST_CASE("Parse strign", "[parse]")
   REQUIRE(pnr.is_male());
 }
 
+TEST_CASE("Compare numbers", "[compare]")
+{
+  Personnummer short_format("900101-0017");
+  Personnummer long_format("19900101-0017");
+  Personnummer no_divider("9001010017");
+  Personnummer plus_divider("900101+0017");
+  Personnummer other("19130401+2931");
+
+  REQUIRE(short_format.canonical_key() == 199001010017ULL);
+  REQUIRE(short_format == long_format);
+  REQUIRE(short_format == no_divider);
+  REQUIRE(short_format == plus_divider);
+  REQUIRE(short_format != other);
+  REQUIRE(other < short_format);
+  REQUIRE_FALSE(short_format < long_format);
+
+  std::unordered_set<Personnummer> unique = {short_format, long_format,
+                                             no_divider, other};
+  REQUIRE(unique.size() == 2);
+  REQUIRE(unique.count(plus_divider) == 1);
+
+  std::set<Personnummer> ordered = {short_format, other, long_format};
+  REQUIRE(ordered.size() == 2);
+  REQUIRE(ordered.begin()->format(true) == "19130401-2931");
+}
+
+TEST_CASE("Deduplicate numbers", "[dedupe]")
+{
+  PersonnummerSet set(1950, 2099);
+
+  REQUIRE(set.insert(Personnummer("19900101-0017")));
+  REQUIRE_FALSE(set.insert(Personnummer("900101-0017")));
+  REQUIRE(set.insert(Personnummer("800161-3294")));
+  REQUIRE(set.contains(Personnummer("9001010017")));
+  REQUIRE_FALSE(set.contains(Personnummer("640327-3813")));
+
+  // Invalid numbers and numbers outside the range are never stored.
+  REQUIRE_FALSE(set.insert(Personnummer("640327-3814")));
+  REQUIRE_FALSE(set.insert(Personnummer("19130401+2931")));
+  REQUIRE_FALSE(set.contains(Personnummer("19130401+2931")));
+  REQUIRE(set.size() == 2);
+
+  set.clear();
+  REQUIRE(set.size() == 0);
+}
+
+TEST_CASE("Deduplicate numbers concurrently", "[dedupe]")
+{
+  PersonnummerSet set(1990, 1990);
+  std::vector<std::string> numbers = {"19900101-0017", "19900101-0025",
+                                      "900101-0017", "9001010025"};
+  std::atomic<int> inserted(0);
+  std::vector<std::thread> threads;
+
+  for (int t = 0; t < 4; ++t)
+  {
+    threads.emplace_back([&]() {
+      for (const auto &nr : numbers)
+      {
+        if (set.insert(Personnummer(nr)))
+          ++inserted;
+      }
+    });
+  }
+
+  for (auto &thread : threads)
+    thread.join();
+
+  REQUIRE(inserted == 2);
+  REQUIRE(set.size() == 2);
+}
+
+TEST_CASE("Binary encoding", "[binary]")
+{
+  std::vector<Personnummer> pnrs = {
+      Personnummer("19900101-0017"),
+      Personnummer("800161-3294"),
+      Personnummer("19130401+2931"),
+  };
+
+  unsigned char record[binary_record_size];
+  encode_binary(pnrs[0], record);
+
+  REQUIRE(record[0] == 0x2e);
+  REQUIRE(decode_binary(record) == pnrs[0]);
+  REQUIRE(decode_binary(record).format(true) == "19900101-0017");
+
+  std::vector<unsigned char> batch(encoded_batch_size(pnrs.size()));
+  REQUIRE(encode_batch(pnrs.data(), pnrs.size(), batch.data()) ==
+          batch.size());
+
+  std::vector<Personnummer> decoded;
+  REQUIRE(decode_batch(batch.data(), batch.size(), decoded));
+  REQUIRE(decoded == pnrs);
+  REQUIRE(decoded[1].is_coordination_number());
+
+  REQUIRE_FALSE(decode_batch(batch.data(), batch.size() - 1, decoded));
+
+  batch[0] = binary_format_version + 1;
+  REQUIRE_FALSE(decode_batch(batch.data(), batch.size(), decoded));
+  REQUIRE(decoded.size() == pnrs.size());
+}
+
+TEST_CASE("Registry index", "[index]")
+{
+  std::vector<std::uint64_t> keys;
+
+  // Spread keys over many years with dense runs to exercise both the
+  // interpolation and the bisection steps.
+  for (std::uint64_t year = 1900; year < 2000; year += 3)
+  {
+    for (std::uint64_t serial = 1; serial < 200; serial += 7)
+      keys.push_back(year * 100000000ULL + 101 * 10000ULL + serial * 10);
+  }
+
+  keys.push_back(Personnummer("19900101-0017").canonical_key());
+  keys.push_back(keys.front());
+
+  std::string path = "personnummer_index_test.idx";
+  REQUIRE(write_index(path, keys));
+
+  PersonnummerIndex index;
+  REQUIRE(index.open(path));
+  REQUIRE(index.size() == keys.size() - 1);
+
+  std::vector<std::uint64_t> sorted(keys.begin(), keys.end() - 1);
+  std::sort(sorted.begin(), sorted.end());
+
+  for (std::size_t i = 0; i < sorted.size(); ++i)
+  {
+    REQUIRE(index.rank(sorted[i]) == i);
+    REQUIRE(index.contains(sorted[i]));
+    REQUIRE_FALSE(index.contains(sorted[i] + 1));
+  }
+
+  REQUIRE(index.contains(Personnummer("900101-0017")));
+  REQUIRE_FALSE(index.contains(Personnummer("800161-3294")));
+  REQUIRE(index.rank(0) == 0);
+  REQUIRE(index.rank(~0ULL) == index.size());
+
+  REQUIRE_FALSE(index.open("missing_personnummer_index.idx"));
+  REQUIRE(index.size() == 0);
+
+  std::remove(path.c_str());
+}
+
+TEST_CASE("View personal identity number", "[view]")
+{
+  std::vector<std::string> cases = {
+      "6403273813",    "510818-9167",   "19900101-0017", "19130401+2931",
+      "196408233234",  "0001010107",    "000101-0107",   "640327-381",
+      "6403273814",    "640327-3814",   "19090903-6600", "20150916-0006",
+      "800161-3294",   "900101",        "9001010017x",   "19900101-00171",
+      "1990010100171", "9001-01-0017",  "",              "900101+001",
+      "199001010017",  "19900101001",   "900101001",     "900101--0017",
+  };
+
+  for (const auto &tc : cases)
+  {
+    std::stringstream case_title;
+    case_title << "Testing " << tc;
+
+    SECTION(case_title.str())
+    {
+      Personnummer pnr(tc);
+      PersonnummerView view(tc);
+
+      REQUIRE(view.canonical_key() == pnr.canonical_key());
+      REQUIRE(view.valid() == pnr.valid());
+      REQUIRE(view.format(true) == pnr.format(true));
+      REQUIRE(view.is_female() == pnr.is_female());
+      REQUIRE(view.is_coordination_number() == pnr.is_coordination_number());
+    }
+  }
+
+  std::string buffer = "id=19900101-0017;";
+  PersonnummerView view(buffer.data() + 3, 13);
+
+  REQUIRE(view.well_formed());
+  REQUIRE(view.valid());
+  REQUIRE(view.is_male());
+  REQUIRE_FALSE(PersonnummerView(buffer).well_formed());
+}
+
+TEST_CASE("Normalize messy input", "[normalize]")
+{
+  // Hex escapes are split from the digits that follow them.
+  std::vector<std::pair<std::string, std::string>> cases = {
+      {"19900101-0017", "19900101-0017"},
+      {" 900101 0017\r\n", "9001010017"},
+      {"\t900101\xc2\xa0-\xc2\xa0"
+       "0017",
+       "900101-0017"},
+      {"900101\xe2\x80\x90"
+       "0017",
+       "900101-0017"},
+      {"900101\xe2\x80\x93"
+       "0017",
+       "900101-0017"},
+      {"900101\xe2\x80\x95"
+       "0017",
+       "900101-0017"},
+      {"900101\xe2\x88\x92"
+       "0017",
+       "900101-0017"},
+      {"\xef\xbc\x99\xef\xbc\x90\xef\xbc\x90\xef\xbc\x91\xef\xbc\x90"
+       "1\xef\xbc\x8d"
+       "0017",
+       "900101-0017"},
+      {"\xef\xbb\xbf"
+       "130401\xef\xbc\x8b"
+       "2931\xe3\x80\x80",
+       "130401+2931"},
+      {"8001\xe2\x80\xaf"
+       "61\xe2\x80\x8b-3294",
+       "800161-3294"},
+  };
+
+  for (const auto &tc : cases)
+  {
+    char buffer[max_formatted_length];
+    std::size_t length =
+        normalize_personnummer(tc.first.data(), tc.first.size(), buffer);
+
+    REQUIRE(std::string(buffer, length) == tc.second);
+
+    NormalizedPersonnummer pnr(tc.first);
+    REQUIRE(pnr.valid());
+    REQUIRE(pnr.view().canonical_key() ==
+            Personnummer(tc.second).canonical_key());
+  }
+
+  // Anything else, and inputs too long to be a number, are rejected.
+  for (std::string messy :
+       {"900101/0017", "9001010017x", "900101\xe2\x80\x96"
+                                      "0017",
+        "900101\xe2\x80", "900101\xc2", "19900101--00170", ""})
+  {
+    char buffer[max_formatted_length];
+
+    REQUIRE(normalize_personnummer(messy.data(), messy.size(), buffer) == 0);
+    REQUIRE_FALSE(NormalizedPersonnummer(messy).well_formed());
+  }
+
+  REQUIRE(NormalizedPersonnummer("900101 - 0018").well_formed());
+  REQUIRE_FALSE(NormalizedPersonnummer("900101 - 0018").valid());
+}
+
+TEST_CASE("Suggest corrections", "[suggest]")
+{
+  std::uint64_t keys[max_suggestions];
+
+  std::size_t count = suggest_corrections("19900101-0018", keys);
+  REQUIRE(std::find(keys, keys + count, 199001010017ULL) != keys + count);
+  REQUIRE(std::is_sorted(keys, keys + count));
+
+  count = suggest_corrections("19900101-0071", keys);
+  REQUIRE(std::find(keys, keys + count, 199001010017ULL) != keys + count);
+
+  // A coordination number can also be fixed by the first digit of its day.
+  count = suggest_corrections("800101-3294", keys);
+  REQUIRE(std::find(keys, keys + count, 198001613294ULL) != keys + count);
+
+  REQUIRE(suggest_corrections("900101-001", keys) == 0);
+  REQUIRE(suggest_corrections("not a number", keys) == 0);
+
+  // Compare with trying every variant, using the view since the regex is slow.
+  std::mt19937 random(5);
+
+  for (int i = 0; i < 2000; ++i)
+  {
+    char digits[11];
+    std::snprintf(digits, sizeof(digits), "%02u%02u%02u%03u%u",
+                  static_cast<unsigned>(random() % 100),
+                  static_cast<unsigned>(random() % 14),
+                  static_cast<unsigned>(random() % 95),
+                  static_cast<unsigned>(random() % 1000),
+                  static_cast<unsigned>(random() % 10));
+    std::string input = "19" + std::string(digits);
+    std::set<std::uint64_t> expected;
+
+    for (std::size_t at = 2; at < input.size(); ++at)
+    {
+      std::string variant = input;
+
+      for (char digit = '0'; digit <= '9'; ++digit)
+      {
+        variant[at] = digit;
+
+        PersonnummerView view(variant);
+
+        if (variant != input && view.valid())
+          expected.insert(view.canonical_key());
+      }
+
+      if (at + 1 < input.size() && input[at] != input[at + 1])
+      {
+        variant = input;
+        std::swap(variant[at], variant[at + 1]);
+
+        PersonnummerView view(variant);
+
+        if (view.valid())
+          expected.insert(view.canonical_key());
+      }
+    }
+
+    count = suggest_corrections(input, keys);
+    REQUIRE(std::vector<std::uint64_t>(keys, keys + count) ==
+            std::vector<std::uint64_t>(expected.begin(), expected.end()));
+  }
+
+  EliasFanoSet registry;
+  registry.build({199001010017ULL});
+  count = suggest_corrections("19900101-0018", 13, keys, registry);
+  REQUIRE(count == 1);
+  REQUIRE(keys[0] == 199001010017ULL);
+  REQUIRE(suggest_corrections("19900101-0035", 13, keys, registry) == 0);
+}
+
+TEST_CASE("Complete control digits", "[control_digit]")
+{
+  std::mt19937 random(9);
+
+  // Every count up to a few registers, so both the vector loop and the tail
+  // are covered.
+  for (std::size_t n = 0; n < 40; ++n)
+  {
+    std::string bodies;
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      char body[body_length + 1];
+      std::snprintf(body, sizeof(body), "%02u%02u%02u%03u",
+                    static_cast<unsigned>(random() % 100),
+                    static_cast<unsigned>(1 + random() % 12),
+                    static_cast<unsigned>(1 + random() % 28 +
+                                          (random() % 2) * coordination_extra),
+                    static_cast<unsigned>(1 + random() % 999));
+      bodies.append(body, body_length);
+    }
+
+    std::string out(n * completed_length, ' ');
+    REQUIRE(complete_control(bodies.data(), n, &out[0]) == n);
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+      std::string record = out.substr(i * completed_length, completed_length);
+
+      REQUIRE(record.compare(0, body_length, bodies, i * body_length,
+                             body_length) == 0);
+      REQUIRE(PersonnummerView(record).valid());
+    }
+  }
+
+  std::string bodies = "900101001800161329900101x01640327381900101001";
+  std::string out(5 * completed_length, ' ');
+
+  REQUIRE(complete_control(bodies.data(), 5, &out[0]) == 4);
+  REQUIRE(out == "9001010017800161329490010"
+                 "1x01?64032738139001010017");
+}
+
+TEST_CASE("Count outcomes", "[stats]")
+{
+  PersonnummerStats before = stats_snapshot();
+
+  std::thread([]() {
+    Personnummer("19900101-0017").valid();
+    Personnummer("800161-3294").valid();
+  }).join();
+
+  Personnummer("not a number").valid();
+  Personnummer("19901301-0017").valid();
+  Personnummer("900101-0000").valid();
+  Personnummer("6403273814").valid();
+  PersonnummerView("900101").valid();
+
+  PersonnummerStats after = stats_snapshot();
+
+  if (!stats_enabled())
+  {
+    REQUIRE(after.parsed == 0);
+    REQUIRE(after.validated == 0);
+    return;
+  }
+
+  REQUIRE(after.parsed - before.parsed == 5);
+  REQUIRE(after.parse_failed - before.parse_failed == 2);
+  REQUIRE(after.validated - before.validated == 6);
+  REQUIRE(after.date_invalid - before.date_invalid == 2);
+  REQUIRE(after.serial_invalid - before.serial_invalid == 1);
+  REQUIRE(after.checksum_invalid - before.checksum_invalid == 1);
+  REQUIRE(after.coordination - before.coordination == 1);
+}
+
+TEST_CASE("Classify identity", "[classify]")
+{
+  std::map<std::string, IdentityType> cases = {
+      {"19900101-0017", IdentityType::personnummer},
+      {"6403273813", IdentityType::personnummer},
+      {"19130401+2931", IdentityType::personnummer},
+      {"800161-3294", IdentityType::samordningsnummer},
+      {"198001613294", IdentityType::samordningsnummer},
+      {"556016-0680", IdentityType::organisationsnummer},
+      {"5560160680", IdentityType::organisationsnummer},
+      {"165560160680", IdentityType::organisationsnummer},
+      {"16556016-0680", IdentityType::organisationsnummer},
+      {"556016-0681", IdentityType::invalid},
+      {"556016+0680", IdentityType::invalid},
+      {"195560160680", IdentityType::invalid},
+      {"556016-068", IdentityType::invalid},
+      {"640327-3814", IdentityType::invalid},
+      {"900101-00171", IdentityType::invalid},
+      {"not a number", IdentityType::invalid},
+  };
+
+  for (const auto &tc : cases)
+  {
+    std::stringstream case_title;
+    case_title << "Testing " << tc.first;
+
+    SECTION(case_title.str())
+    {
+      REQUIRE(classify_identity(tc.first).type == tc.second);
+    }
+  }
+
+  Identity personal = classify_identity("800161-3294");
+  REQUIRE(personal.year == 1980);
+  REQUIRE(personal.month == 1);
+  REQUIRE(personal.day == 61);
+  REQUIRE(personal.number == 329);
+  REQUIRE(personal.control == 4);
+  REQUIRE(personal.key == Personnummer("800161-3294").canonical_key());
+
+  Identity organisation = classify_identity("556016-0680");
+  REQUIRE(organisation.key == 5560160680ULL);
+  REQUIRE(organisation.control == 0);
+}
+
+TEST_CASE("Find numbers in text", "[scan]")
+{
+  std::string text = "2024-01-01 12:00:00 kund 19900101-0017 ringde om "
+                     "800161-3294, ref 9001010017 och 6403273814 samt "
+                     "119900101-0017 och 19900101-00171 och x640327-3813";
+
+  std::vector<ScanMatch> matches = find_all_personnummer(text);
+  std::vector<std::string> found;
+
+  for (const auto &match : matches)
+    found.push_back(text.substr(match.offset, match.length));
+
+  std::vector<std::string> expected = {"19900101-0017", "800161-3294",
+                                       "9001010017", "640327-3813"};
+  REQUIRE(found == expected);
+
+  ScanMatch first[2];
+  REQUIRE(find_personnummer(text.data(), text.size(), 0, first, 2) == 2);
+  REQUIRE(find_personnummer(text.data(), text.size(),
+                            first[1].offset + first[1].length, first, 2) == 2);
+  REQUIRE(text.substr(first[0].offset, first[0].length) == "9001010017");
+
+  // Starting in the middle of a number must not find its tail.
+  REQUIRE(find_personnummer(text.data(), text.size(), matches[0].offset + 2,
+                            first, 1) == 1);
+  REQUIRE(first[0].offset == matches[1].offset);
+
+  REQUIRE(find_all_personnummer("9001010017").size() == 1);
+  REQUIRE(find_all_personnummer("").empty());
+}
+
+TEST_CASE("C interface", "[capi]")
+{
+  std::vector<std::string> numbers = {"19900101-0017", "800161-3294",
+                                      "640327-3814", "not a number"};
+  std::vector<const char *> inputs;
+  std::vector<size_t> lengths;
+
+  for (const auto &nr : numbers)
+  {
+    inputs.push_back(nr.data());
+    lengths.push_back(nr.size());
+  }
+
+  REQUIRE(pnr_abi_version() == PNR_ABI_VERSION);
+  REQUIRE(sizeof(pnr_record) == 8);
+
+  std::vector<uint8_t> valid(numbers.size());
+  REQUIRE(pnr_validate_batch(inputs.data(), lengths.data(), numbers.size(),
+                             valid.data()) == 2);
+  REQUIRE(valid == std::vector<uint8_t>({1, 1, 0, 0}));
+
+  std::vector<pnr_record> records(numbers.size());
+  REQUIRE(pnr_parse_batch(inputs.data(), lengths.data(), numbers.size(),
+                          records.data()) == 2);
+  REQUIRE(records[0].year == 1990);
+  REQUIRE(records[0].serial == 1);
+  REQUIRE(records[0].control == 7);
+  REQUIRE(records[0].flags == (PNR_WELL_FORMED | PNR_VALID));
+  REQUIRE(records[1].day == 61);
+  REQUIRE(records[1].flags == (PNR_WELL_FORMED | PNR_VALID | PNR_COORDINATION));
+  REQUIRE(records[2].flags == PNR_WELL_FORMED);
+  REQUIRE(records[3].flags == 0);
+
+  std::vector<char> out(numbers.size() * PNR_FORMAT_STRIDE);
+  REQUIRE(pnr_format_batch(records.data(), records.size(), 1, out.data()) ==
+          records.size());
+  REQUIRE(std::string(out.data()) == "19900101-0017");
+  REQUIRE(std::string(out.data() + PNR_FORMAT_STRIDE) == "19800161-3294");
+  REQUIRE(std::string(out.data() + 3 * PNR_FORMAT_STRIDE) == "");
+}
+
+TEST_CASE("Arrow export", "[capi]")
+{
+  std::vector<std::string> numbers = {"19900101-0017", "800161-3294",
+                                      "640327-3814", "not a number",
+                                      "19900230-0004"};
+  std::vector<const char *> inputs;
+  std::vector<size_t> lengths;
+
+  for (const auto &nr : numbers)
+  {
+    inputs.push_back(nr.data());
+    lengths.push_back(nr.size());
+  }
+
+  std::vector<pnr_record> records(numbers.size());
+  pnr_parse_batch(inputs.data(), lengths.data(), numbers.size(),
+                  records.data());
+
+  ArrowSchema schema;
+  ArrowArray array;
+  REQUIRE(pnr_export_arrow(records.data(), records.size(), &schema, &array) ==
+          0);
+
+  REQUIRE(std::string(schema.format) == "+s");
+  REQUIRE(schema.n_children == 5);
+  REQUIRE(std::string(schema.children[0]->name) == "birth_date");
+  REQUIRE(std::string(schema.children[0]->format) == "tdD");
+  REQUIRE(std::string(schema.children[3]->format) == "b");
+
+  REQUIRE(array.length == 5);
+  REQUIRE(array.null_count == 1);
+  REQUIRE(array.n_children == 5);
+
+  const uint8_t *well_formed = static_cast<const uint8_t *>(array.buffers[0]);
+  REQUIRE((well_formed[0] & 0x1f) == 0x17);
+
+  const int32_t *birth_dates =
+      static_cast<const int32_t *>(array.children[0]->buffers[1]);
+  REQUIRE(birth_dates[0] == Personnummer("19900101-0017").birth_days());
+  REQUIRE(birth_dates[1] == days_from_civil(1980, 1, 1));
+  REQUIRE(birth_dates[2] == days_from_civil(1964, 3, 27));
+
+  // February 30 is well formed but has no birth date.
+  const uint8_t *dated =
+      static_cast<const uint8_t *>(array.children[0]->buffers[0]);
+  REQUIRE((dated[0] & 0x1f) == 0x7);
+  REQUIRE(array.children[0]->null_count == 2);
+  REQUIRE(array.children[1]->buffers[0] == nullptr);
+
+  const uint16_t *serials =
+      static_cast<const uint16_t *>(array.children[1]->buffers[1]);
+  const uint8_t *controls =
+      static_cast<const uint8_t *>(array.children[2]->buffers[1]);
+  REQUIRE(serials[1] == 329);
+  REQUIRE(controls[1] == 4);
+
+  const uint8_t *valid =
+      static_cast<const uint8_t *>(array.children[3]->buffers[1]);
+  REQUIRE((valid[0] & 0x1f) == 0x3);
+
+  const uint8_t *types =
+      static_cast<const uint8_t *>(array.children[4]->buffers[1]);
+  REQUIRE(types[0] == PNR_ARROW_PERSONNUMMER);
+  REQUIRE(types[1] == PNR_ARROW_COORDINATION);
+
+  // A child moved out stays valid after its parent is released.
+  ArrowArray moved = *array.children[1];
+  array.children[1]->release = nullptr;
+  array.release(&array);
+  schema.release(&schema);
+  REQUIRE(array.release == nullptr);
+  REQUIRE(schema.release == nullptr);
+
+  REQUIRE(static_cast<const uint16_t *>(moved.buffers[1])[0] == 1);
+  moved.release(&moved);
+  REQUIRE(moved.release == nullptr);
+
+  REQUIRE(pnr_export_arrow(nullptr, 0, &schema, &array) == 0);
+  REQUIRE(array.length == 0);
+  array.release(&array);
+  schema.release(&schema);
+}
+
+TEST_CASE("Ring buffer", "[pipeline]")
+{
+  SpscRing<int> ring(3);
+  int value = 0;
+
+  for (int i = 0; i < 4; ++i)
+    REQUIRE(ring.try_push(i));
+
+  REQUIRE_FALSE(ring.try_push(4));
+  REQUIRE(ring.try_pop(value));
+  REQUIRE(value == 0);
+  REQUIRE(ring.try_push(4));
+
+  for (int i = 1; i <= 4; ++i)
+  {
+    REQUIRE(ring.try_pop(value));
+    REQUIRE(value == i);
+  }
+
+  REQUIRE_FALSE(ring.try_pop(value));
+}
+
+TEST_CASE("Validation pipeline", "[pipeline]")
+{
+  std::string input;
+  std::string expected;
+
+  for (int i = 0; i < 1000; ++i)
+  {
+    input += "19900101-0017\n640327-3814\r\n\n";
+    expected += "19900101-0017\tvalid\n640327-3814\r\tinvalid\n\tinvalid\n";
+  }
+
+  input += "800161-3294";
+  expected += "800161-3294\tvalid\n";
+
+  std::FILE *in = std::tmpfile();
+  std::FILE *out = std::tmpfile();
+  REQUIRE(in != nullptr);
+  REQUIRE(out != nullptr);
+
+  std::fwrite(input.data(), 1, input.size(), in);
+  std::rewind(in);
+
+  // Small chunks so lines are split between chunks.
+  PipelineOptions options;
+  options.chunk_size = 64;
+  options.chunks = 4;
+
+  PipelineStats stats = run_pipeline(in, out, options);
+
+  REQUIRE_FALSE(stats.failed);
+  REQUIRE(stats.records == 3001);
+  REQUIRE(stats.valid == 1001);
+  REQUIRE(stats.reader.bytes == input.size());
+  REQUIRE(stats.writer.bytes == expected.size());
+
+  std::string output(expected.size() + 1, '\0');
+  std::rewind(out);
+  output.resize(std::fread(&output[0], 1, output.size(), out));
+
+  REQUIRE(output == expected);
+
+  std::fclose(in);
+  std::fclose(out);
+}
+
+TEST_CASE("Validation pipeline with overlong lines", "[pipeline]")
+{
+  std::string overlong(150, '1');
+  std::string input = "19900101-0017\n" + overlong + "\n800161-3294\n" +
+                      overlong + "19900101-0017\n19900101-0017\n" + overlong;
+  std::string head(64, '1');
+  std::string expected = "19900101-0017\tvalid\n" + head +
+                         "\tinvalid\n800161-3294\tvalid\n" + head +
+                         "\tinvalid\n19900101-0017\tvalid\n" + head +
+                         "\tinvalid\n";
+
+  std::FILE *in = std::tmpfile();
+  std::FILE *out = std::tmpfile();
+  REQUIRE(in != nullptr);
+  REQUIRE(out != nullptr);
+
+  std::fwrite(input.data(), 1, input.size(), in);
+  std::rewind(in);
+
+  PipelineOptions options;
+  options.chunk_size = 64;
+  options.chunks = 4;
+
+  PipelineStats stats = run_pipeline(in, out, options);
+
+  REQUIRE_FALSE(stats.failed);
+  REQUIRE(stats.records == 6);
+  REQUIRE(stats.valid == 3);
+
+  std::string output(expected.size() + 1, '\0');
+  std::rewind(out);
+  output.resize(std::fread(&output[0], 1, output.size(), out));
+
+  REQUIRE(output == expected);
+
+  std::fclose(in);
+  std::fclose(out);
+}
+
+TEST_CASE("Validation pipeline with lines of exactly chunk_size", "[pipeline]")
+{
+  std::string input = "19900101-0017\n800161-3294\n19900101-00171\n"
+                      "19900101-0017";
+  std::string expected = "19900101-0017\tvalid\n800161-3294\tvalid\n"
+                         "19900101-0017\tinvalid\n19900101-0017\tvalid\n";
+
+  std::FILE *in = std::tmpfile();
+  std::FILE *out = std::tmpfile();
+  REQUIRE(in != nullptr);
+  REQUIRE(out != nullptr);
+
+  std::fwrite(input.data(), 1, input.size(), in);
+  std::rewind(in);
+
+  // Room for exactly one number per chunk.
+  PipelineOptions options;
+  options.chunk_size = 13;
+  options.chunks = 4;
+
+  PipelineStats stats = run_pipeline(in, out, options);
+
+  REQUIRE_FALSE(stats.failed);
+  REQUIRE(stats.records == 4);
+  REQUIRE(stats.valid == 3);
+
+  std::string output(expected.size() + 1, '\0');
+  std::rewind(out);
+  output.resize(std::fread(&output[0], 1, output.size(), out));
+
+  REQUIRE(output == expected);
+
+  std::fclose(in);
+  std::fclose(out);
+}
+
+#ifndef _WIN32
+TEST_CASE("Input backends", "[pipeline]")
+{
+  std::string input;
+
+  for (int i = 0; i < 100000; ++i)
+    input += i % 3 ? "19900101-0017\n" : "640327-3814\n";
+
+  input += "800161-3294";
+
+  std::FILE *file = std::tmpfile();
+  REQUIRE(file != nullptr);
+  std::fwrite(input.data(), 1, input.size(), file);
+  std::fflush(file);
+
+  const InputBackend backends[] = {InputBackend::read, InputBackend::pread,
+                                   InputBackend::mmap, InputBackend::io_uring};
+
+  for (InputBackend backend : backends)
+  {
+    InputBackend parsed;
+    REQUIRE(parse_backend(backend_name(backend), parsed));
+    REQUIRE(parsed == backend);
+
+    // Start at the beginning and at an offset that isn't on a page boundary,
+    // with blocks and reads of odd sizes so reads straddle blocks.
+    for (off_t start : {0, 5000})
+    {
+      REQUIRE(lseek(fileno(file), start, SEEK_SET) == start);
+      std::string output;
+
+      {
+        InputReader reader(fileno(file), backend, 4099, 3);
+        char buffer[1000];
+        std::size_t got;
+
+        do
+        {
+          got = reader.read(buffer, sizeof(buffer));
+          output.append(buffer, got);
+        } while (got == sizeof(buffer));
+
+        INFO(backend_name(backend) << " as " << backend_name(reader.backend()));
+        REQUIRE_FALSE(reader.failed());
+      }
+
+      REQUIRE(output == input.substr(start));
+      REQUIRE(lseek(fileno(file), 0, SEEK_CUR) ==
+              static_cast<off_t>(input.size()));
+    }
+  }
+
+  InputBackend parsed;
+  REQUIRE_FALSE(parse_backend("aio", parsed));
+
+  // Not a regular file, so the reader falls back to read(2).
+  int pipe_fds[2];
+  REQUIRE(pipe(pipe_fds) == 0);
+  REQUIRE(write(pipe_fds[1], "800161-3294\n", 12) == 12);
+  close(pipe_fds[1]);
+
+  InputReader reader(pipe_fds[0], InputBackend::mmap);
+  REQUIRE(reader.backend() == InputBackend::read);
+
+  std::FILE *out = std::tmpfile();
+  REQUIRE(out != nullptr);
+
+  PipelineStats stats = run_pipeline(reader, out);
+  REQUIRE_FALSE(stats.failed);
+  REQUIRE(stats.records == 1);
+  REQUIRE(stats.valid == 1);
+
+  close(pipe_fds[0]);
+  std::fclose(out);
+  std::fclose(file);
+}
+#endif
+
+TEST_CASE("Format into arena", "[format]")
+{
+  std::vector<Personnummer> pnrs = {
+      Personnummer("9001018080"),
+      Personnummer("19130401+2931"),
+      Personnummer("800161-3294"),
+  };
+
+  FormatArena arena;
+  REQUIRE(arena.append(pnrs.data(), pnrs.size(), true) == 0);
+  REQUIRE(arena.append(pnrs.data(), 1) == 3);
+  REQUIRE(arena.size() == 4);
+
+  REQUIRE(arena.str(0) == "19900101-8080");
+  REQUIRE(arena.str(1) == "19130401-2931");
+  REQUIRE(arena.str(2) == "19800161-3294");
+  REQUIRE(arena.str(3) == "900101-8080");
+  REQUIRE(arena[3].offset == 3 * 13);
+  REQUIRE(arena[3].length == 11);
+  REQUIRE(std::string(arena.data(), 13) == "19900101-8080");
+
+  arena.clear();
+  REQUIRE(arena.size() == 0);
+}
+
+TEST_CASE("Age columns", "[age]")
+{
+  std::vector<Personnummer> pnrs = {
+      Personnummer("19900101-0017"), Personnummer("800161-3294"),
+      Personnummer("19130401+2931"), Personnummer("6403273813"),
+      Personnummer("0001010107"),
+  };
+
+  std::vector<std::int32_t> dates(pnrs.size());
+  birth_date_column(pnrs.data(), pnrs.size(), dates.data());
+  REQUIRE(dates[0] == 19900101);
+  REQUIRE(dates[1] == 19800101);
+
+  std::vector<std::int32_t> ages(pnrs.size());
+  ages_at(dates.data(), dates.size(), today_yyyymmdd(), ages.data());
+
+  for (std::size_t i = 0; i < pnrs.size(); ++i)
+    REQUIRE(ages[i] == pnrs[i].get_age());
+
+  // A coordination number is as old as a person born on its actual day, also
+  // in the month of birth.
+  std::int32_t today = today_yyyymmdd();
+
+  for (int day = 1; day <= 28; ++day)
+  {
+    std::uint64_t key = 1990ULL * 100000000 + (today / 100 % 100) * 1000000ULL +
+                        day * 10000ULL + 170;
+    Personnummer pnr = Personnummer::from_canonical_key(key);
+    Personnummer coordination =
+        Personnummer::from_canonical_key(key + coordination_extra * 10000ULL);
+    int expected = today / 10000 - 1990 - (day > today % 100 ? 1 : 0);
+
+    REQUIRE(pnr.get_age() == expected);
+    REQUIRE(coordination.get_age() == expected);
+  }
+
+  // Birthdays around the reference date, including leap days and dates after
+  // the reference date, in a column long enough to use the vector code.
+  std::vector<std::int32_t> birth_dates;
+
+  for (int year = 1990; year <= 2021; ++year)
+  {
+    for (int mmdd : {101, 228, 229, 301, 1018, 1019, 1020, 1231})
+      birth_dates.push_back(year * 10000 + mmdd);
+  }
+
+  const std::int32_t reference = 20201019;
+  ages.resize(birth_dates.size());
+  ages_at(birth_dates.data(), birth_dates.size(), reference, ages.data());
+
+  for (std::size_t i = 0; i < birth_dates.size(); ++i)
+  {
+    int year = birth_dates[i] / 10000;
+    int mmdd = birth_dates[i] % 10000;
+    int expected = 2020 - year - (mmdd > 1019 ? 1 : 0);
+
+    REQUIRE(ages[i] == expected);
+  }
+
+  std::vector<std::uint64_t> mask((birth_dates.size() + 63) / 64);
+  std::size_t adults = age_at_least(birth_dates.data(), birth_dates.size(),
+                                    reference, 18, mask.data());
+  std::size_t expected_adults = 0;
+
+  for (std::size_t i = 0; i < birth_dates.size(); ++i)
+  {
+    bool adult = ages[i] >= 18;
+    expected_adults += adult ? 1 : 0;
+
+    REQUIRE(((mask[i / 64] >> (i % 64)) & 1) == (adult ? 1u : 0u));
+  }
+
+  REQUIRE(adults == expected_adults);
+}
+
+TEST_CASE("Days since epoch", "[days]")
+{
+  REQUIRE(days_from_civil(1970, 1, 1) == 0);
+  REQUIRE(days_from_civil(1969, 12, 31) == -1);
+  REQUIRE(days_from_civil(2000, 3, 1) == 11017);
+  REQUIRE(days_from_civil(1600, 2, 29) == -135081);
+
+  // Every day for a few centuries round trips and follows the previous day.
+  int previous = days_from_civil(1799, 12, 31);
+
+  for (int year = 1800; year < 2200; ++year)
+  {
+    for (int month = 1; month <= 12; ++month)
+    {
+      for (int day = 1; day <= 31; ++day)
+      {
+        if (!valid_date(year, month, day))
+          continue;
+
+        int days = days_from_civil(year, month, day);
+        REQUIRE(days == previous + 1);
+        previous = days;
+
+        int y, m, d;
+        civil_from_days(days, y, m, d);
+        REQUIRE((y == year && m == month && d == day));
+      }
+    }
+  }
+
+  Personnummer pnr("19900101-0017");
+  REQUIRE(pnr.birth_days() == 7305);
+  REQUIRE(Personnummer("800161-3294").birth_days() ==
+          days_from_civil(1980, 1, 1));
+  REQUIRE(pnr.birth_days() - Personnummer("19891231-0000").birth_days() == 1);
+}
+
+TEST_CASE("Radix sort", "[sort]")
+{
+  std::mt19937_64 random(42);
+  std::vector<std::uint64_t> keys(300000);
+
+  for (auto &key : keys)
+    key = random() % 1000000000000ULL;
+
+  // Few distinct values in the upper digits to exercise skipped passes.
+  keys[0] = 0;
+  keys[1] = keys[2];
+
+  std::vector<std::uint64_t> expected = keys;
+  std::sort(expected.begin(), expected.end());
+
+  for (unsigned threads : {1u, 3u})
+  {
+    std::vector<std::uint64_t> sorted = keys;
+    radix_sort(sorted.data(), sorted.size(), threads);
+    REQUIRE(sorted == expected);
+  }
+
+  std::vector<std::uint64_t> same(1000, 199001010017ULL);
+  radix_sort(same.data(), same.size());
+  REQUIRE(same == std::vector<std::uint64_t>(1000, 199001010017ULL));
+
+  std::vector<Personnummer> pnrs = {
+      Personnummer("19900101-0017"), Personnummer("800161-3294"),
+      Personnummer("19130401+2931"), Personnummer("900101-0017"),
+  };
+  radix_sort(pnrs);
+
+  REQUIRE(pnrs[0].format(true) == "19130401-2931");
+  REQUIRE(pnrs[1].format(true) == "19800161-3294");
+  REQUIRE(pnrs[2] == pnrs[3]);
+}
+
+TEST_CASE("Group by birth date", "[sort]")
+{
+  std::vector<std::uint64_t> keys = {
+      Personnummer("19900101-0017").canonical_key(),
+      Personnummer("800161-3294").canonical_key(),
+      Personnummer("19130401+2931").canonical_key(),
+      Personnummer("19800101-0018").canonical_key(),
+      Personnummer("19900101-0025").canonical_key(),
+  };
+  std::vector<std::uint64_t> grouped(keys.size());
+
+  std::vector<std::size_t> years = group_by_birth_year(
+      keys.data(), keys.size(), 1950, 1999, grouped.data());
+  REQUIRE(years.size() == 51);
+  REQUIRE(years.back() == 4);
+  REQUIRE(years[1980 - 1950 + 1] - years[1980 - 1950] == 2);
+  REQUIRE(grouped[0] == keys[1]);
+  REQUIRE(grouped[1] == keys[3]);
+  REQUIRE(grouped[2] == keys[0]);
+  REQUIRE(grouped[3] == keys[4]);
+
+  std::vector<std::size_t> days = group_by_birth_date(
+      keys.data(), keys.size(), 1900, 1999, grouped.data());
+  int first_day = days_from_civil(1900, 1, 1);
+  int day = days_from_civil(1980, 1, 1) - first_day;
+
+  REQUIRE(days.back() == 5);
+  REQUIRE(days[day + 1] - days[day] == 2);
+  REQUIRE(grouped[0] == keys[2]);
+  REQUIRE(grouped[1] == keys[1]);
+
+  // Dates that don't exist aren't put in any day.
+  keys.push_back(199013010017ULL);
+  keys.push_back(199002310017ULL);
+  keys.push_back(199002910017ULL);
+  grouped.resize(keys.size());
+
+  days = group_by_birth_date(keys.data(), keys.size(), 1900, 1999,
+                             grouped.data());
+  REQUIRE(days.back() == 5);
+}
+
+TEST_CASE("Elias-Fano set", "[elias_fano]")
+{
+  std::mt19937_64 random(7);
+  std::vector<std::uint64_t> keys;
+
+  // Dense runs of serial numbers on random days, like a real registry.
+  for (int i = 0; i < 2000; ++i)
+  {
+    std::uint64_t day = 190001010000ULL + (random() % 1200) * 100000000ULL +
+                        (random() % 12) * 1000000ULL + (random() % 28) * 10000;
+
+    for (int serial = random() % 50; serial < 1000; serial += 1 + random() % 40)
+      keys.push_back(day + serial * 10 + random() % 10);
+  }
+
+  keys.push_back(keys.front());
+  keys.push_back(Personnummer("800161-3294").canonical_key());
+
+  EliasFanoSet set;
+  set.build(keys);
+
+  std::set<std::uint64_t> expected(keys.begin(), keys.end());
+  REQUIRE(set.size() == expected.size());
+  REQUIRE(set.memory_usage() < expected.size() * 4);
+
+  std::vector<std::uint64_t> sorted(expected.begin(), expected.end());
+  REQUIRE(std::vector<std::uint64_t>(set.begin(), set.end()) == sorted);
+
+  std::string path = "personnummer_elias_fano_test.ef";
+  REQUIRE(set.write(path));
+
+  EliasFanoSet loaded;
+  REQUIRE(loaded.open(path));
+  REQUIRE(loaded.size() == sorted.size());
+
+  for (std::size_t i = 0; i < sorted.size(); i += 7)
+  {
+    REQUIRE(loaded.contains(sorted[i]));
+    REQUIRE(loaded.rank(sorted[i]) == i);
+    REQUIRE(loaded.contains(sorted[i] + 1) == expected.count(sorted[i] + 1));
+    REQUIRE(loaded.rank(sorted[i] + 1) == i + 1);
+  }
+
+  // Keys that can't be numbers are never contained but still ranked.
+  for (std::uint64_t day : {190013010000ULL, 190001000000ULL, 190001450000ULL,
+                            190001990000ULL, 190012990000ULL})
+  {
+    REQUIRE_FALSE(loaded.contains(day));
+    REQUIRE(loaded.rank(day) == static_cast<std::size_t>(std::distance(
+                                    expected.begin(), expected.lower_bound(day))));
+  }
+
+  REQUIRE(loaded.rank(0) == 0);
+  REQUIRE(loaded.rank(~0ULL) == sorted.size());
+  REQUIRE_FALSE(loaded.contains(~0ULL));
+
+  // Truncated files and headers that don't match the data are rejected.
+  std::vector<char> bytes;
+  {
+    std::FILE *in = std::fopen(path.c_str(), "rb");
+    REQUIRE(in != nullptr);
+    char buffer[4096];
+    std::size_t n;
+
+    while ((n = std::fread(buffer, 1, sizeof(buffer), in)) > 0)
+      bytes.insert(bytes.end(), buffer, buffer + n);
+
+    std::fclose(in);
+  }
+
+  auto write_bytes = [&](const std::vector<char> &content) {
+    std::FILE *out = std::fopen(path.c_str(), "wb");
+    REQUIRE(out != nullptr);
+    std::fwrite(content.data(), 1, content.size(), out);
+    std::fclose(out);
+  };
+
+  write_bytes(std::vector<char>(bytes.begin(), bytes.end() - 8));
+  REQUIRE_FALSE(loaded.open(path));
+
+  // The header's count, low bits and upper words, which follow the magic,
+  // version and byte order.
+  for (std::size_t offset : {16, 24, 40})
+  {
+    std::vector<char> corrupt = bytes;
+    corrupt[offset + 1] ^= 1;
+    write_bytes(corrupt);
+    REQUIRE_FALSE(loaded.open(path));
+    REQUIRE(loaded.size() == 0);
+  }
+
+  // The last sample, off by one but still pointing into the upper bits.
+  {
+    std::vector<char> corrupt = bytes;
+    corrupt[corrupt.size() - 8] ^= 1;
+    write_bytes(corrupt);
+    REQUIRE_FALSE(loaded.open(path));
+  }
+
+  write_bytes(bytes);
+  REQUIRE(loaded.open(path));
+  std::remove(path.c_str());
+
+  // Only the range of years in the set costs space.
+  std::vector<std::uint64_t> recent;
+
+  for (std::uint64_t key : keys)
+    recent.push_back(key % 100000000 + 2000 * 100000000ULL +
+                     key / 100000000 % 10 * 100000000ULL);
+
+  EliasFanoSet narrow;
+  narrow.build(recent);
+  REQUIRE(narrow.contains(recent.back()));
+  REQUIRE(*narrow.begin() >= 200000000000ULL);
+
+  // At most 2 + ceil(log2(U / n)) bits per key, plus the samples and padding.
+  double universe = 10 * 12 * 62 * 10000.0;
+  double bits = 2 + std::ceil(std::log2(universe / narrow.size())) + 0.5;
+  REQUIRE(narrow.memory_usage() * 8 <= narrow.size() * bits + 3 * 64);
+
+  EliasFanoSet small;
+  small.build({Personnummer("19900101-0017").canonical_key(), 0});
+  REQUIRE(small.size() == 1);
+  REQUIRE(small.contains(Personnummer("900101-0017")));
+  REQUIRE_FALSE(small.contains(0));
+  REQUIRE(small.rank(199001010018ULL) == 1);
+
+  EliasFanoSet empty;
+  empty.build({});
+  REQUIRE(empty.begin() == empty.end());
+  REQUIRE_FALSE(empty.contains(0));
+  REQUIRE_FALSE(empty.open("missing_personnummer_set.ef"));
+}
+
+TEST_CASE("Xor filter", "[xor_filter]")
+{
+  std::mt19937_64 random(11);
+  std::vector<std::uint64_t> keys;
+  std::unordered_set<std::uint64_t> members;
+
+  for (int i = 0; i < 100000; ++i)
+  {
+    keys.push_back(190001010000ULL + (random() % 120) * 100000000ULL +
+                   (random() % 12) * 1000000ULL + (random() % 28) * 10000 +
+                   random() % 10000);
+    members.insert(keys.back());
+  }
+
+  keys.push_back(keys.front());
+
+  XorFilter filter;
+  REQUIRE(filter.build(keys));
+  REQUIRE(filter.size() == members.size());
+  REQUIRE(filter.memory_usage() < members.size() * 13 / 10);
+
+  for (std::uint64_t key : keys)
+    REQUIRE(filter.contains(key));
+
+  // Other keys pass at a rate of about 1/256.
+  std::vector<std::uint64_t> others;
+
+  while (others.size() < 100000)
+  {
+    std::uint64_t key = random() % 1000000000000ULL;
+
+    if (members.count(key) == 0)
+      others.push_back(key);
+  }
+
+  std::unique_ptr<bool[]> result(new bool[others.size()]);
+  std::size_t passed =
+      filter.contains(others.data(), others.size(), result.get());
+  REQUIRE(passed < others.size() / 128);
+
+  for (std::size_t i = 0; i < others.size(); i += 13)
+    REQUIRE(result[i] == filter.contains(others[i]));
+
+  std::string path = "personnummer_xor_filter_test.xf";
+  REQUIRE(filter.write(path));
+
+  XorFilter loaded;
+  REQUIRE(loaded.open(path));
+  REQUIRE(loaded.size() == filter.size());
+  result.reset(new bool[keys.size()]);
+  REQUIRE(loaded.contains(keys.data(), keys.size(), result.get()) ==
+          keys.size());
+  REQUIRE(loaded.contains(Personnummer("19000101-0000").canonical_key()) ==
+          filter.contains(Personnummer("19000101-0000")));
+  std::remove(path.c_str());
+
+  XorFilter empty;
+  REQUIRE(empty.build({}));
+  REQUIRE_FALSE(empty.contains(keys.front()));
+  REQUIRE_FALSE(empty.open(path));
+}
+
 // vim: set ts=2 sw=2 et:
@@ -0,0 +1,192 @@
+#include "elias_fano.hpp"
+#include "registry_index.hpp"
+#include "view.hpp"
+#include "xor_filter.hpp"
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+ * Check personal identity numbers against a blocklist. A xor filter built from
+ * the blocklist rules out almost all numbers that aren't on it; only the rest
+ * are looked up in the exact index, if one is given. Numbers are read from
+ * stdin, one per line, and written to stdout followed by a tab and "blocked",
+ * "clear", or "maybe" when there's no index to confirm a filter hit with.
+ *
+ *   pnr-blocklist build blocklist.xf < blocked.txt
+ *   pnr-blocklist check blocklist.xf [blocklist.idx] < incoming.txt
+ */
+// Lines checked against the filter together.
+const std::size_t batch_lines = 4096;
+
+struct Counts
+{
+  std::size_t lines;
+  std::size_t filter_hits;
+  std::size_t blocked;
+};
+
+int usage()
+{
+  std::cerr << "usage: pnr-blocklist build <filter-file> < numbers\n"
+               "       pnr-blocklist check <filter-file> [<index-file>] "
+               "< numbers\n";
+  return 2;
+}
+
+int build(const std::string &path)
+{
+  std::vector<std::uint64_t> keys;
+  std::string line;
+  std::size_t invalid = 0;
+
+  while (std::getline(std::cin, line))
+  {
+    PersonnummerView pnr(line);
+
+    if (!pnr.valid())
+    {
+      ++invalid;
+      continue;
+    }
+
+    keys.push_back(pnr.canonical_key());
+  }
+
+  XorFilter filter;
+
+  if (!filter.build(keys) || !filter.write(path))
+  {
+    std::cerr << "failed to write filter " << path << "\n";
+    return 1;
+  }
+
+  std::cerr << "added " << filter.size() << " numbers in "
+            << filter.memory_usage() << " bytes, skipped " << invalid
+            << " invalid\n";
+
+  return 0;
+}
+
+class ExactIndex
+{
+  PersonnummerIndex index;
+  EliasFanoSet set;
+  bool compact;
+
+public:
+  ExactIndex() : compact(false) {}
+
+  bool open(const std::string &path)
+  {
+    if (index.open(path))
+      return true;
+
+    compact = set.open(path);
+
+    return compact;
+  }
+
+  bool contains(std::uint64_t key) const
+  {
+    return compact ? set.contains(key) : index.contains(key);
+  }
+};
+
+void check_batch(const XorFilter &filter, const ExactIndex *exact,
+                 const std::vector<std::string> &lines,
+                 std::vector<std::uint64_t> &keys, bool *hits, Counts &counts)
+{
+  keys.clear();
+
+  // Invalid numbers get ~0ULL, which no number has, to keep the batch aligned.
+  // The filter hashes it like any key, a hit on it is ignored below so
+  // invalid lines are always reported clear.
+  for (const std::string &line : lines)
+  {
+    PersonnummerView pnr(line);
+    keys.push_back(pnr.valid() ? pnr.canonical_key() : ~0ULL);
+  }
+
+  counts.lines += lines.size();
+  counts.filter_hits += filter.contains(keys.data(), keys.size(), hits);
+
+  for (std::size_t i = 0; i < lines.size(); ++i)
+  {
+    const char *status = "\tclear\n";
+
+    if (hits[i] && keys[i] != ~0ULL)
+    {
+      if (exact == nullptr)
+        status = "\tmaybe\n";
+      else if (exact->contains(keys[i]))
+        status = "\tblocked\n";
+    }
+
+    counts.blocked += status[1] == 'b';
+    std::cout << lines[i] << status;
+  }
+}
+
+int check(const std::string &filter_path, const std::string &index_path)
+{
+  XorFilter filter;
+  ExactIndex exact;
+
+  if (!filter.open(filter_path))
+  {
+    std::cerr << "failed to open filter " << filter_path << "\n";
+    return 1;
+  }
+
+  if (!index_path.empty() && !exact.open(index_path))
+  {
+    std::cerr << "failed to open index " << index_path << "\n";
+    return 1;
+  }
+
+  std::vector<std::string> lines;
+  std::vector<std::uint64_t> keys;
+  std::unique_ptr<bool[]> hits(new bool[batch_lines]);
+  Counts counts = {0, 0, 0};
+  std::string line;
+
+  while (std::getline(std::cin, line))
+  {
+    lines.push_back(line);
+
+    if (lines.size() == batch_lines)
+    {
+      check_batch(filter, index_path.empty() ? nullptr : &exact, lines, keys,
+                  hits.get(), counts);
+      lines.clear();
+    }
+  }
+
+  check_batch(filter, index_path.empty() ? nullptr : &exact, lines, keys,
+              hits.get(), counts);
+
+  std::cerr << counts.lines << " lines, " << counts.filter_hits
+            << " passed the filter, " << counts.blocked << " blocked\n";
+
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 3)
+    return usage();
+
+  std::string command = argv[1];
+
+  if (command == "build" && argc == 3)
+    return build(argv[2]);
+
+  if (command == "check" && argc <= 4)
+    return check(argv[2], argc == 4 ? argv[3] : "");
+
+  return usage();
+}
+
+// vim: set ts=2 sw=2 et:
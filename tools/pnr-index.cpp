@@ -0,0 +1,128 @@
+#include "elias_fano.hpp"
+#include "registry_index.hpp"
+#include "view.hpp"
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+ * Build an index of known personal identity numbers or check numbers against
+ * one. Numbers are read from stdin, one per line.
+ *
+ *   pnr-index build registry.idx < known.txt
+ *   pnr-index build --compact registry.ef < known.txt
+ *   pnr-index query registry.idx < incoming.txt
+ *
+ * A compact index is Elias-Fano encoded, see `EliasFanoSet` for its size.
+ * Queries work with both kinds.
+ */
+int usage()
+{
+  std::cerr << "usage: pnr-index build [--compact] <index-file> < numbers\n"
+               "       pnr-index query <index-file> < numbers\n";
+  return 2;
+}
+
+int build(const std::string &path, bool compact)
+{
+  std::vector<std::uint64_t> keys;
+  std::string line;
+  std::size_t invalid = 0;
+
+  while (std::getline(std::cin, line))
+  {
+    PersonnummerView pnr(line);
+
+    if (!pnr.valid())
+    {
+      ++invalid;
+      continue;
+    }
+
+    keys.push_back(pnr.canonical_key());
+  }
+
+  bool written;
+
+  if (compact)
+  {
+    EliasFanoSet set;
+    set.build(keys);
+    written = set.write(path);
+  }
+  else
+  {
+    written = write_index(path, keys);
+  }
+
+  if (!written)
+  {
+    std::cerr << "failed to write index " << path << "\n";
+    return 1;
+  }
+
+  std::cerr << "indexed " << keys.size() << " numbers, skipped " << invalid
+            << " invalid\n";
+
+  return 0;
+}
+
+int query(const std::string &path)
+{
+  PersonnummerIndex index;
+  EliasFanoSet set;
+  bool compact = false;
+
+  if (!index.open(path))
+  {
+    compact = set.open(path);
+
+    if (!compact)
+    {
+      std::cerr << "failed to open index " << path << "\n";
+      return 1;
+    }
+  }
+
+  std::string line;
+
+  while (std::getline(std::cin, line))
+  {
+    PersonnummerView pnr(line);
+    bool known = false;
+
+    if (pnr.valid())
+    {
+      std::uint64_t key = pnr.canonical_key();
+      known = compact ? set.contains(key) : index.contains(key);
+    }
+
+    std::cout << line << (known ? "\tknown\n" : "\tunknown\n");
+  }
+
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc < 3)
+    return usage();
+
+  std::string command = argv[1];
+
+  if (command == "build" && argc == 4 && std::string(argv[2]) == "--compact")
+    return build(argv[3], true);
+
+  if (argc != 3)
+    return usage();
+
+  if (command == "build")
+    return build(argv[2], false);
+
+  if (command == "query")
+    return query(argv[2]);
+
+  return usage();
+}
+
+// vim: set ts=2 sw=2 et:
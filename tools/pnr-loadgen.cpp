@@ -0,0 +1,304 @@
+#include "view.hpp"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <netinet/in.h>
+#include <poll.h>
+#include <random>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+/*
+ * Load generator for pnr-server. Every connection runs on its own thread and
+ * sends `--lines` lines in batches of `--depth`, waiting for all answers to a
+ * batch before sending the next. Answers are checked against the library and the
+ * throughput and batch round trip times are reported.
+ *
+ *   pnr-loadgen --port 7878 [--connections 4] [--lines 1000000] [--depth 256]
+ *   pnr-loadgen --unix /run/pnr.sock [...]
+ */
+struct Options
+{
+  int port;
+  std::string unix_path;
+  std::size_t connections;
+  std::size_t lines;
+  std::size_t depth;
+};
+
+struct Result
+{
+  std::size_t lines;
+  std::size_t mismatches;
+  bool failed;
+  std::vector<double> round_trips;
+};
+
+int usage()
+{
+  std::cerr << "usage: pnr-loadgen --port PORT | --unix PATH [--connections N] "
+               "[--lines N] [--depth N]\n";
+  return 2;
+}
+
+int connect_to(const Options &options)
+{
+  int fd;
+
+  if (options.port)
+  {
+    sockaddr_in address = sockaddr_in();
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<std::uint16_t>(options.port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    if (fd >= 0 &&
+        connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)))
+    {
+      close(fd);
+      return -1;
+    }
+  }
+  else
+  {
+    sockaddr_un address = sockaddr_un();
+    address.sun_family = AF_UNIX;
+
+    if (options.unix_path.size() >= sizeof(address.sun_path))
+      return -1;
+
+    std::memcpy(address.sun_path, options.unix_path.c_str(),
+                options.unix_path.size() + 1);
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (fd >= 0 &&
+        connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)))
+    {
+      close(fd);
+      return -1;
+    }
+  }
+
+  if (fd >= 0)
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+  return fd;
+}
+
+/*
+ * Send one batch and read its answers, writing and reading as the socket
+ * allows so a batch larger than the socket buffers can't deadlock.
+ */
+bool round_trip(int fd, const std::string &request, std::size_t lines,
+                std::string &answers)
+{
+  std::size_t sent = 0;
+  std::size_t newlines = 0;
+  char buffer[65536];
+
+  answers.clear();
+
+  while (newlines < lines)
+  {
+    pollfd poller = {fd, static_cast<short>(
+                             POLLIN | (sent < request.size() ? POLLOUT : 0)),
+                     0};
+
+    if (poll(&poller, 1, -1) < 0 && errno != EINTR)
+      return false;
+
+    if (poller.revents & POLLOUT)
+    {
+      ssize_t n = send(fd, request.data() + sent, request.size() - sent, 0);
+
+      if (n < 0 && errno != EAGAIN && errno != EINTR)
+        return false;
+
+      sent += n > 0 ? static_cast<std::size_t>(n) : 0;
+    }
+
+    if (poller.revents & (POLLIN | POLLHUP | POLLERR))
+    {
+      ssize_t n = recv(fd, buffer, sizeof(buffer), 0);
+
+      if (n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR))
+        return false;
+
+      if (n > 0)
+      {
+        answers.append(buffer, static_cast<std::size_t>(n));
+        newlines += std::count(buffer, buffer + n, '\n');
+      }
+    }
+  }
+
+  return true;
+}
+
+void run_connection(const Options &options,
+                    const std::vector<std::string> &numbers,
+                    const std::vector<bool> &expected, unsigned seed,
+                    Result &result)
+{
+  int fd = connect_to(options);
+  result.failed = fd < 0;
+
+  if (result.failed)
+    return;
+
+  std::mt19937 random(seed);
+  std::string request;
+  std::string answers;
+  std::vector<std::size_t> picked;
+
+  while (result.lines < options.lines)
+  {
+    std::size_t batch = std::min(options.depth, options.lines - result.lines);
+
+    request.clear();
+    picked.clear();
+
+    for (std::size_t i = 0; i < batch; ++i)
+    {
+      picked.push_back(random() % numbers.size());
+      request += numbers[picked.back()];
+      request += '\n';
+    }
+
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+
+    if (!round_trip(fd, request, batch, answers))
+    {
+      result.failed = true;
+      break;
+    }
+
+    result.round_trips.push_back(
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+            .count());
+
+    std::size_t at = 0;
+
+    for (std::size_t i = 0; i < batch; ++i)
+    {
+      std::size_t end = answers.find('\n', at);
+      bool valid = answers.compare(at, end - at, "valid") == 0;
+
+      result.mismatches += valid != expected[picked[i]];
+      at = end + 1;
+    }
+
+    result.lines += batch;
+  }
+
+  close(fd);
+}
+
+int main(int argc, char **argv)
+{
+  Options options = {0, "", 4, 1000000, 256};
+
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    if (std::strcmp(argv[i], "--port") == 0)
+      options.port = std::atoi(argv[i + 1]);
+    else if (std::strcmp(argv[i], "--unix") == 0)
+      options.unix_path = argv[i + 1];
+    else if (std::strcmp(argv[i], "--connections") == 0)
+      options.connections = std::strtoul(argv[i + 1], nullptr, 10);
+    else if (std::strcmp(argv[i], "--lines") == 0)
+      options.lines = std::strtoul(argv[i + 1], nullptr, 10);
+    else if (std::strcmp(argv[i], "--depth") == 0)
+      options.depth = std::strtoul(argv[i + 1], nullptr, 10);
+    else
+      return usage();
+  }
+
+  if (argc % 2 == 0 || (options.port == 0) == options.unix_path.empty() ||
+      options.connections == 0 || options.depth == 0)
+    return usage();
+
+  // Mostly valid numbers, in the formats clients send.
+  std::mt19937 random(1);
+  std::vector<std::string> numbers;
+  std::vector<bool> expected;
+
+  for (int i = 0; i < 4096; ++i)
+  {
+    char body[10];
+    std::snprintf(body, sizeof(body), "%02u%02u%02u%03u",
+                  static_cast<unsigned>(random() % 100),
+                  static_cast<unsigned>(1 + random() % 12),
+                  static_cast<unsigned>(1 + random() % 28),
+                  static_cast<unsigned>(random() % 1000));
+    int control = i % 4 ? luhn(body, body + 9) : random() % 10;
+
+    numbers.push_back((i % 2 ? "19" : "") + std::string(body, 6) +
+                      (i % 3 ? "-" : "") + std::string(body + 6, 3) +
+                      static_cast<char>('0' + control));
+    expected.push_back(PersonnummerView(numbers.back()).valid());
+  }
+
+  std::vector<Result> results(options.connections);
+  std::vector<std::thread> threads;
+  std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+
+  for (std::size_t i = 0; i < options.connections; ++i)
+    threads.emplace_back(run_connection, std::cref(options), std::cref(numbers),
+                         std::cref(expected), static_cast<unsigned>(i + 1),
+                         std::ref(results[i]));
+
+  for (std::thread &thread : threads)
+    thread.join();
+
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  std::size_t lines = 0;
+  std::size_t mismatches = 0;
+  bool failed = false;
+  std::vector<double> round_trips;
+
+  for (const Result &result : results)
+  {
+    lines += result.lines;
+    mismatches += result.mismatches;
+    failed |= result.failed;
+    round_trips.insert(round_trips.end(), result.round_trips.begin(),
+                       result.round_trips.end());
+  }
+
+  std::sort(round_trips.begin(), round_trips.end());
+
+  std::cout << lines << " lines over " << options.connections
+            << " connections in " << seconds << " s ("
+            << lines / (seconds > 0 ? seconds : 1e-9) / 1e6 << " M lines/s)\n";
+
+  if (!round_trips.empty())
+    std::cout << "round trip of " << options.depth << " lines: p50 "
+              << round_trips[round_trips.size() / 2] * 1e6 << " us, p99 "
+              << round_trips[round_trips.size() * 99 / 100] * 1e6 << " us\n";
+
+  if (mismatches > 0)
+    std::cout << mismatches << " answers differ from the library\n";
+
+  if (failed)
+    std::cerr << "a connection failed\n";
+
+  return failed || mismatches > 0 ? 1 : 0;
+}
+
+// vim: set ts=2 sw=2 et:
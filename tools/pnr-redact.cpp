@@ -0,0 +1,150 @@
+#include "scan.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+/*
+ * Copy stdin to stdout and redact every valid personal identity number on the
+ * way. By default the serial number and control digit are masked so the output
+ * keeps the date (19900101-0017 becomes 19900101-XXXX), with `--token` the
+ * whole number is replaced by the given text.
+ *
+ *   pnr-redact < app.log > redacted.log
+ *   pnr-redact --token '[PNR]' < app.log > redacted.log
+ *
+ * Input is handled as soon as it arrives and the output is flushed after
+ * every read, so it also works as a filter on a live log (`tail -f app.log |
+ * pnr-redact`).
+ */
+const std::size_t buffer_size = 64 * 1024;
+
+// A number starting before this many bytes from the end of the buffer is
+// followed by at least one byte, so we know where it ends.
+const std::size_t lookahead = 14;
+
+char buffer[buffer_size];
+
+bool write_output(const char *data, std::size_t length)
+{
+  return std::fwrite(data, 1, length, stdout) == length;
+}
+
+/*
+ * Read what is available from stdin, up to `size` bytes. Unlike `fread` this
+ * returns as soon as some input has arrived. Returns -1 on errors.
+ */
+long read_input(char *data, std::size_t size)
+{
+  for (;;)
+  {
+#ifdef _WIN32
+    long n = _read(0, data, static_cast<unsigned>(size));
+#else
+    long n = static_cast<long>(::read(0, data, size));
+#endif
+
+    if (n >= 0 || errno != EINTR)
+      return n;
+  }
+}
+
+int usage()
+{
+  std::cerr << "usage: pnr-redact [--token TEXT] < input > output\n";
+  return 2;
+}
+
+int main(int argc, char **argv)
+{
+  const char *token = nullptr;
+
+  if (argc == 3 && std::strcmp(argv[1], "--token") == 0)
+    token = argv[2];
+  else if (argc != 1)
+    return usage();
+
+  std::size_t token_length = token ? std::strlen(token) : 0;
+  std::size_t length = 0;
+  std::size_t from = 0;
+  std::size_t written = 0;
+  bool eof = false;
+
+  while (!eof)
+  {
+    long read = read_input(buffer + length, buffer_size - length);
+
+    if (read < 0)
+      return 1;
+
+    length += static_cast<std::size_t>(read);
+    eof = read == 0;
+
+    // Matches starting at or after the limit are handled with the next read,
+    // when we can see what follows them. No number continues past a line
+    // break, so input ending with one is handled in full right away.
+    std::size_t limit = eof || (length > 0 && buffer[length - 1] == '\n')
+                            ? length
+                        : length > lookahead ? length - lookahead
+                                             : 0;
+    ScanMatch matches[64];
+    std::size_t found;
+
+    do
+    {
+      found = find_personnummer(buffer, length, from, matches, 64);
+
+      for (std::size_t i = 0; i < found; ++i)
+      {
+        const ScanMatch &match = matches[i];
+
+        if (match.offset >= limit)
+        {
+          found = 0;
+          break;
+        }
+
+        from = match.offset + match.length;
+
+        if (token)
+        {
+          if (!write_output(buffer + written, match.offset - written) ||
+              !write_output(token, token_length))
+            return 1;
+
+          written = from;
+        }
+        else
+        {
+          std::memset(buffer + from - 4, 'X', 4);
+        }
+      }
+    } while (found == 64);
+
+    std::size_t done = std::max(written, limit);
+
+    if (!write_output(buffer + written, done - written) ||
+        std::fflush(stdout) != 0)
+      return 1;
+
+    // Keep the last byte already handled so the scanner can tell whether the
+    // next byte continues a digit run.
+    std::size_t keep_from = done > 0 ? done - 1 : 0;
+    std::memmove(buffer, buffer + keep_from, length - keep_from);
+    length -= keep_from;
+    from = std::max(from, done) - keep_from;
+    written = done - keep_from;
+  }
+
+  return 0;
+}
+
+// vim: set ts=2 sw=2 et:
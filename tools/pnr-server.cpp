@@ -0,0 +1,472 @@
+#include "personnummer_c.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <netinet/in.h>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+/*
+ * Validation server for running next to services that don't link the library.
+ * Clients send numbers separated by newlines and get one line back for each,
+ * "valid" or "invalid", in the same order. Any number of lines may be sent
+ * before reading the answers.
+ *
+ * Every thread runs its own epoll loop. The listening socket is added to all
+ * of them with EPOLLEXCLUSIVE so a new connection wakes one thread, which then
+ * serves the connection for its whole life. Connection buffers are allocated
+ * once at startup and complete lines are validated in batches straight from
+ * the input buffer, so serving requests never allocates.
+ *
+ *   pnr-server --port 7878 [--threads N] [--max-connections N]
+ *   pnr-server --unix /run/pnr.sock [--threads N] [--max-connections N]
+ */
+#ifndef EPOLLEXCLUSIVE
+#define EPOLLEXCLUSIVE (1u << 28)
+#endif
+
+// Longer lines can't be numbers, they are answered with "invalid" as a whole.
+const std::size_t input_size = 4096;
+const std::size_t output_size = 8192;
+
+// Lines validated together, and the longest answer to one of them.
+const std::size_t batch_size = 256;
+const std::size_t max_answer = sizeof("invalid\n") - 1;
+
+const std::uint32_t listener_id = ~0u;
+
+struct Connection
+{
+  int fd;
+  std::size_t in_used;
+  std::size_t out_begin;
+  std::size_t out_end;
+  std::uint32_t events;
+  bool discarding;
+  bool closing;
+  char in[input_size];
+  char out[output_size];
+};
+
+class Worker
+{
+  int epoll_fd;
+  int listen_fd;
+  std::vector<Connection> connections;
+  std::vector<std::uint32_t> free_slots;
+  const char *inputs[batch_size];
+  std::size_t lengths[batch_size];
+  std::uint8_t valid[batch_size];
+
+  void accept_all();
+  void close_connection(std::uint32_t id);
+  void watch(std::uint32_t id, std::uint32_t events);
+  void handle(std::uint32_t id, std::uint32_t events);
+  bool read_input(Connection &connection);
+  bool answer_lines(Connection &connection);
+  void answer_batch(Connection &connection, std::size_t count);
+  bool flush(Connection &connection);
+
+public:
+  Worker(int listen_fd, std::size_t max_connections);
+  ~Worker();
+
+  bool start();
+  void run();
+};
+
+Worker::Worker(int listen_fd, std::size_t max_connections)
+    : epoll_fd(-1), listen_fd(listen_fd), connections(max_connections)
+{
+  for (std::size_t i = max_connections; i-- > 0;)
+    free_slots.push_back(static_cast<std::uint32_t>(i));
+}
+
+Worker::~Worker()
+{
+  if (epoll_fd >= 0)
+    close(epoll_fd);
+}
+
+bool Worker::start()
+{
+  epoll_fd = epoll_create1(0);
+
+  epoll_event event = epoll_event();
+  event.events = EPOLLIN | EPOLLEXCLUSIVE;
+  event.data.u32 = listener_id;
+
+  return epoll_fd >= 0 &&
+         epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event) == 0;
+}
+
+void Worker::run()
+{
+  epoll_event events[64];
+
+  for (;;)
+  {
+    int ready = epoll_wait(epoll_fd, events, 64, -1);
+
+    for (int i = 0; i < ready; ++i)
+    {
+      if (events[i].data.u32 == listener_id)
+        accept_all();
+      else
+        handle(events[i].data.u32, events[i].events);
+    }
+  }
+}
+
+void Worker::accept_all()
+{
+  for (;;)
+  {
+    int fd = accept4(listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+    if (fd < 0)
+      return;
+
+    if (free_slots.empty())
+    {
+      close(fd);
+      continue;
+    }
+
+    std::uint32_t id = free_slots.back();
+    free_slots.pop_back();
+
+    Connection &connection = connections[id];
+    connection.fd = fd;
+    connection.in_used = connection.out_begin = connection.out_end = 0;
+    connection.events = EPOLLIN | EPOLLRDHUP;
+    connection.discarding = connection.closing = false;
+
+    epoll_event event = epoll_event();
+    event.events = connection.events;
+    event.data.u32 = id;
+
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0)
+      close_connection(id);
+  }
+}
+
+void Worker::close_connection(std::uint32_t id)
+{
+  close(connections[id].fd);
+  connections[id].fd = -1;
+  free_slots.push_back(id);
+}
+
+void Worker::watch(std::uint32_t id, std::uint32_t events)
+{
+  if (connections[id].events == events)
+    return;
+
+  connections[id].events = events;
+
+  epoll_event event = epoll_event();
+  event.events = events;
+  event.data.u32 = id;
+  epoll_ctl(epoll_fd, EPOLL_CTL_MOD, connections[id].fd, &event);
+}
+
+/*
+ * Read and answer as much as fits in the output buffer. While answers can't
+ * be written the connection waits for the client to read them instead of
+ * reading more, so a client that doesn't read only fills its own buffers.
+ */
+void Worker::handle(std::uint32_t id, std::uint32_t events)
+{
+  Connection &connection = connections[id];
+
+  if (events & EPOLLERR)
+  {
+    close_connection(id);
+    return;
+  }
+
+  for (;;)
+  {
+    bool used = answer_lines(connection);
+
+    if (!flush(connection))
+    {
+      close_connection(id);
+      return;
+    }
+
+    // Wait for the client to read its answers.
+    if (connection.out_end > 0)
+      break;
+
+    if (used)
+      continue;
+
+    if (connection.closing ||
+        (!read_input(connection) && !connection.closing))
+      break;
+  }
+
+  if (connection.out_end > 0)
+    watch(id, EPOLLOUT);
+  else if (connection.closing)
+    close_connection(id);
+  else
+    watch(id, EPOLLIN | EPOLLRDHUP);
+}
+
+/*
+ * Read what's available into the input buffer, which must not be full.
+ * Returns false if nothing was read. When the client is done sending
+ * `closing` is set, and a last line without a newline is still answered.
+ */
+bool Worker::read_input(Connection &connection)
+{
+  ssize_t n = read(connection.fd, connection.in + connection.in_used,
+                   input_size - connection.in_used);
+
+  if (n > 0)
+  {
+    connection.in_used += static_cast<std::size_t>(n);
+    return true;
+  }
+
+  if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+    return false;
+
+  if (n == 0 && connection.in_used > 0 && !connection.discarding)
+  {
+    connection.in[connection.in_used++] = '\n';
+    connection.closing = true;
+    return true;
+  }
+
+  connection.closing = true;
+
+  return false;
+}
+
+/*
+ * Answer the complete lines in the input buffer, as many as there is room for
+ * in the output buffer. Returns false if nothing in the buffer was used.
+ */
+bool Worker::answer_lines(Connection &connection)
+{
+  std::size_t start = 0;
+  std::size_t count = 0;
+
+  for (;;)
+  {
+    // Only take lines that can be answered right away.
+    if (connection.out_end + (count + 1) * max_answer > output_size)
+      break;
+
+    const char *newline = static_cast<const char *>(
+        std::memchr(connection.in + start, '\n', connection.in_used - start));
+
+    if (newline == nullptr)
+      break;
+
+    std::size_t end = static_cast<std::size_t>(newline - connection.in);
+    std::size_t length = end - start;
+
+    if (length > 0 && connection.in[end - 1] == '\r')
+      --length;
+
+    if (connection.discarding)
+      connection.discarding = false;
+    else
+    {
+      inputs[count] = connection.in + start;
+      lengths[count] = length;
+      ++count;
+    }
+
+    start = end + 1;
+
+    if (count == batch_size)
+    {
+      answer_batch(connection, count);
+      count = 0;
+    }
+  }
+
+  answer_batch(connection, count);
+
+  // A full buffer without a newline holds part of a line that is too long.
+  // The line is answered once, when its start is seen, and then skipped.
+  if (start == 0 && connection.in_used == input_size &&
+      connection.out_end + max_answer <= output_size)
+  {
+    if (!connection.discarding)
+    {
+      inputs[0] = connection.in;
+      lengths[0] = 0;
+      answer_batch(connection, 1);
+      connection.discarding = true;
+    }
+
+    start = connection.in_used;
+  }
+
+  std::memmove(connection.in, connection.in + start,
+               connection.in_used - start);
+  connection.in_used -= start;
+
+  return start > 0;
+}
+
+void Worker::answer_batch(Connection &connection, std::size_t count)
+{
+  pnr_validate_batch(inputs, lengths, count, valid);
+
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    const char *answer = valid[i] ? "valid\n" : "invalid\n";
+    std::size_t length = valid[i] ? 6 : 8;
+
+    std::memcpy(connection.out + connection.out_end, answer, length);
+    connection.out_end += length;
+  }
+}
+
+/*
+ * Write pending answers. Returns false if the connection is broken.
+ */
+bool Worker::flush(Connection &connection)
+{
+  while (connection.out_begin < connection.out_end)
+  {
+    ssize_t n = write(connection.fd, connection.out + connection.out_begin,
+                      connection.out_end - connection.out_begin);
+
+    if (n < 0)
+      return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+
+    connection.out_begin += static_cast<std::size_t>(n);
+  }
+
+  connection.out_begin = connection.out_end = 0;
+
+  return true;
+}
+
+int usage()
+{
+  std::cerr << "usage: pnr-server --port PORT | --unix PATH [--threads N] "
+               "[--max-connections N]\n";
+  return 2;
+}
+
+int listen_tcp(int port)
+{
+  int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  int on = 1;
+  sockaddr_in address = sockaddr_in();
+  address.sin_family = AF_INET;
+  address.sin_port = htons(static_cast<std::uint16_t>(port));
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  if (fd < 0 || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) ||
+      bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) ||
+      listen(fd, SOMAXCONN))
+    return -1;
+
+  return fd;
+}
+
+int listen_unix(const std::string &path)
+{
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  sockaddr_un address = sockaddr_un();
+  address.sun_family = AF_UNIX;
+
+  if (fd < 0 || path.size() >= sizeof(address.sun_path))
+    return -1;
+
+  std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+  unlink(path.c_str());
+
+  if (bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) ||
+      listen(fd, SOMAXCONN))
+    return -1;
+
+  return fd;
+}
+
+int main(int argc, char **argv)
+{
+  int port = 0;
+  std::string unix_path;
+  std::size_t threads = std::max(1u, std::thread::hardware_concurrency());
+  std::size_t max_connections = 256;
+
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    if (std::strcmp(argv[i], "--port") == 0)
+      port = std::atoi(argv[i + 1]);
+    else if (std::strcmp(argv[i], "--unix") == 0)
+      unix_path = argv[i + 1];
+    else if (std::strcmp(argv[i], "--threads") == 0)
+      threads = std::strtoul(argv[i + 1], nullptr, 10);
+    else if (std::strcmp(argv[i], "--max-connections") == 0)
+      max_connections = std::strtoul(argv[i + 1], nullptr, 10);
+    else
+      return usage();
+  }
+
+  if (argc % 2 == 0 || (port == 0) == unix_path.empty() || threads == 0 ||
+      max_connections == 0)
+    return usage();
+
+  // Clients that disconnect early must not kill the server.
+  std::signal(SIGPIPE, SIG_IGN);
+
+  int listen_fd = port ? listen_tcp(port) : listen_unix(unix_path);
+
+  if (listen_fd < 0)
+  {
+    std::cerr << "failed to listen: " << std::strerror(errno) << "\n";
+    return 1;
+  }
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::vector<std::thread> loops;
+
+  for (std::size_t i = 0; i < threads; ++i)
+  {
+    workers.emplace_back(new Worker(listen_fd, max_connections));
+
+    if (!workers.back()->start())
+    {
+      std::cerr << "failed to start event loop: " << std::strerror(errno)
+                << "\n";
+      return 1;
+    }
+  }
+
+  std::cerr << "listening on "
+            << (port ? "127.0.0.1:" + std::to_string(port) : unix_path)
+            << " with " << threads << " threads\n";
+
+  for (auto &worker : workers)
+    loops.emplace_back(&Worker::run, worker.get());
+
+  for (std::thread &loop : loops)
+    loop.join();
+
+  return 0;
+}
+
+// vim: set ts=2 sw=2 et:
@@ -0,0 +1,84 @@
+#include "pipeline.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+/*
+ * Validate personal identity numbers in bulk, one per line. Every line is
+ * written to stdout followed by a tab and "valid" or "invalid". Throughput of
+ * each stage is reported on stderr. With `--backend` stdin is read through
+ * read(2), pread(2), mmap(2) or io_uring instead of stdio; the last three need
+ * stdin to be a regular file.
+ *
+ *   pnr-validate [--chunk-size BYTES] [--chunks N] [--backend NAME]
+ *                < numbers.txt
+ */
+int usage()
+{
+  std::cerr << "usage: pnr-validate [--chunk-size BYTES] [--chunks N] "
+               "[--backend stdio|read|pread|mmap|io_uring] < input > output\n";
+  return 2;
+}
+
+void report(const char *name, const StageStats &stage)
+{
+  double busy = stage.busy_seconds > 0 ? stage.busy_seconds : 1e-9;
+
+  std::cerr << "  " << name << ": " << stage.chunks << " chunks, "
+            << stage.bytes / busy / 1e6 << " MB/s busy, " << stage.busy_seconds
+            << " s busy, " << stage.stalled_seconds << " s stalled\n";
+}
+
+int main(int argc, char **argv)
+{
+  PipelineOptions options;
+  InputBackend backend = InputBackend::stdio;
+
+  for (int i = 1; i < argc; ++i)
+  {
+    if (i + 1 < argc && std::strcmp(argv[i], "--chunk-size") == 0)
+      options.chunk_size = std::strtoul(argv[++i], nullptr, 10);
+    else if (i + 1 < argc && std::strcmp(argv[i], "--chunks") == 0)
+      options.chunks = std::strtoul(argv[++i], nullptr, 10);
+    else if (i + 1 < argc && std::strcmp(argv[i], "--backend") == 0)
+    {
+      if (!parse_backend(argv[++i], backend))
+        return usage();
+    }
+    else
+      return usage();
+  }
+
+  if (options.chunk_size == 0)
+    return usage();
+
+  std::unique_ptr<InputReader> reader(
+      backend == InputBackend::stdio
+          ? new InputReader(stdin)
+          : new InputReader(fileno(stdin), backend, options.chunk_size));
+  PipelineStats stats = run_pipeline(*reader, stdout, options);
+
+  if (reader->backend() != backend)
+    std::cerr << backend_name(backend) << " is not available, used "
+              << backend_name(reader->backend()) << "\n";
+
+  std::cerr << stats.records << " records, " << stats.valid << " valid in "
+            << stats.seconds << " s ("
+            << stats.records / (stats.seconds > 0 ? stats.seconds : 1e-9) / 1e6
+            << " M records/s)\n";
+  report("reader", stats.reader);
+  report("parser", stats.parser);
+  report("writer", stats.writer);
+
+  if (stats.failed)
+  {
+    std::cerr << "failed to read input or write output\n";
+    return 1;
+  }
+
+  return 0;
+}
+
+// vim: set ts=2 sw=2 et: